@@ -11,22 +11,303 @@
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/CFG.h"
 
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Pass.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/CaptureTracking.h"
 #include "llvm/Analysis/LoopAnalysisManager.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/LoopIterator.h"
 #include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/MustExecute.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
 
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 
+#include "llvm/Support/CommandLine.h"
+
+#include <optional>
+
+#define DEBUG_TYPE "simple-licm"
+
+STATISTIC(NumHoisted, "The # of hoisted instructions");
+STATISTIC(NumPressureVetoed,
+          "The # of hoists vetoed by the register pressure model");
+
 using namespace llvm;
 
+// The fixed-point search is kept as a reference for the single-pass search:
+// both find the same invariant set (see utils/simple_licm_bench.py).
+static cl::opt<bool> UseFixedPoint(
+    "simple-licm-fixed-point", cl::init(false),
+    cl::desc("Find invariants by rescanning the loop until nothing changes"));
+
+static cl::opt<bool> Promote(
+    "simple-licm-promote", cl::init(false),
+    cl::desc("Keep invariant memory locations that the loop reads and "
+             "writes in registers (needs loop-mssa)"));
+
+static cl::opt<bool> Sink(
+    "simple-licm-sink", cl::init(true),
+    cl::desc("Move instructions used only after the loop to the exit blocks"));
+
+static cl::opt<unsigned> SpeculateCost(
+    "simple-licm-speculate-cost", cl::init(1),
+    cl::desc("Largest TargetTransformInfo cost of a safe invariant that is "
+             "hoisted from a conditional block (1: TCC_Basic)"));
+
+static cl::opt<bool> GuardedHoist(
+    "simple-licm-guard", cl::init(false),
+    cl::desc("Hoist expensive invariants that may trap into a preheader "
+             "block guarded by the invariant branch they depend on"));
+
+static cl::opt<bool> RegPressure(
+    "simple-licm-reg-pressure", cl::init(false),
+    cl::desc("Keep cheap invariants in the loop when hoisting them would "
+             "need more registers than the target has"));
+
+static cl::opt<unsigned> RegBudget(
+    "simple-licm-reg-budget", cl::init(0),
+    cl::desc("Registers per register class for -simple-licm-reg-pressure "
+             "(0: ask TargetTransformInfo)"));
+
+// Estimates the number of registers a loop needs, per register class of
+// TargetTransformInfo. A value defined before the loop and used in it is
+// live across the whole body. For the loop-variant values, liveness is
+// solved over the loop blocks and the largest number live at one point is
+// taken. Invariant instructions are left out of that: once hoisted they
+// are live across the loop, and one kept in the loop is recomputed next
+// to its users. The estimate is updated as instructions are hoisted: a
+// hoisted value with users left in the loop becomes live across it, and
+// an operand whose last user in the loop was hoisted no longer is.
+class LoopRegPressure {
+  Loop &L;
+  const TargetTransformInfo &TTI;
+  const SmallPtrSetImpl<Instruction *> &Invariants;
+  SmallPtrSet<Value *, 16> LiveAcross;
+  SmallDenseMap<unsigned, unsigned, 4> NumLiveAcross;
+  SmallDenseMap<unsigned, unsigned, 4> MaxInLoop;
+
+public:
+  LoopRegPressure(Loop &L, const TargetTransformInfo &TTI,
+                  const SmallPtrSetImpl<Instruction *> &Invariants)
+      : L(L), TTI(TTI), Invariants(Invariants) {
+    for (BasicBlock *BB : L.blocks())
+      for (Instruction &I : *BB)
+        for (Value *Op : I.operands())
+          updateLiveAcross(Op);
+    computeMaxInLoop();
+  }
+
+  static bool needsRegister(const Value *V) {
+    if (!isa<Instruction>(V) && !isa<Argument>(V))
+      return false;
+    Type *Ty = V->getType();
+    return !Ty->isVoidTy() && !Ty->isTokenTy() && !Ty->isMetadataTy() &&
+           !Ty->isLabelTy();
+  }
+
+  unsigned getClass(const Value *V) const {
+    Type *Ty = V->getType();
+    return TTI.getRegisterClassForType(Ty->isVectorTy(), Ty);
+  }
+
+  unsigned getPressure(unsigned ClassID) const {
+    return NumLiveAcross.lookup(ClassID) + MaxInLoop.lookup(ClassID);
+  }
+
+  unsigned getBudget(unsigned ClassID) const {
+    return RegBudget ? RegBudget : TTI.getNumberOfRegisters(ClassID);
+  }
+
+  // Pressure in I's register class if I is moved to the preheader while
+  // some of its users stay in the loop. Operands used in the loop only by
+  // I stop being live across it.
+  unsigned getPressureAfterHoisting(Instruction &I) const {
+    unsigned ClassID = getClass(&I);
+    unsigned Pressure = getPressure(ClassID) + 1;
+    SmallPtrSet<Value *, 4> Seen;
+    for (Value *Op : I.operands())
+      if (Seen.insert(Op).second && LiveAcross.count(Op) &&
+          getClass(Op) == ClassID && !isUsedInLoop(Op, &I) && Pressure)
+        --Pressure;
+    return Pressure;
+  }
+
+  void hoisted(Instruction &I) {
+    updateLiveAcross(&I);
+    for (Value *Op : I.operands())
+      updateLiveAcross(Op);
+  }
+
+private:
+  bool isUsedInLoop(Value *V, Instruction *Ignore = nullptr) const {
+    return llvm::any_of(V->users(), [&](User *U) {
+      auto *UI = dyn_cast<Instruction>(U);
+      return UI && UI != Ignore && L.contains(UI->getParent());
+    });
+  }
+
+  // Keeps LiveAcross to the values defined outside the loop and used in it
+  void updateLiveAcross(Value *V) {
+    if (!needsRegister(V))
+      return;
+    if (auto *I = dyn_cast<Instruction>(V))
+      if (L.contains(I->getParent()))
+        return;
+    if (isUsedInLoop(V)) {
+      if (LiveAcross.insert(V).second)
+        ++NumLiveAcross[getClass(V)];
+    } else if (LiveAcross.erase(V)) {
+      --NumLiveAcross[getClass(V)];
+    }
+  }
+
+  bool isInLoopValue(Value *V) const {
+    auto *I = dyn_cast<Instruction>(V);
+    return I && needsRegister(I) && L.contains(I->getParent()) &&
+           !Invariants.count(I);
+  }
+
+  // Backward liveness of the loop-variant values. A phi's incoming
+  // value is live out of the matching predecessor, the phi itself is live
+  // in to its block. Then every block is walked bottom-up from its live-out
+  // set to find the largest live set per register class.
+  void computeMaxInLoop() {
+    DenseMap<BasicBlock *, SmallPtrSet<Value *, 16>> LiveIn, LiveOut;
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (BasicBlock *BB : L.blocks()) {
+        SmallPtrSet<Value *, 16> Out;
+        for (BasicBlock *Succ : successors(BB)) {
+          // Only the LCSSA phis of an exit block use loop values
+          if (L.contains(Succ))
+            for (Value *V : LiveIn[Succ])
+              if (!isa<PHINode>(V) || cast<PHINode>(V)->getParent() != Succ)
+                Out.insert(V);
+          for (PHINode &PN : Succ->phis())
+            if (isInLoopValue(PN.getIncomingValueForBlock(BB)))
+              Out.insert(PN.getIncomingValueForBlock(BB));
+        }
+        SmallPtrSet<Value *, 16> In(Out.begin(), Out.end());
+        for (Instruction &I : llvm::reverse(*BB)) {
+          In.erase(&I);
+          if (isa<PHINode>(I)) {
+            if (needsRegister(&I))
+              In.insert(&I);
+            continue;
+          }
+          for (Value *Op : I.operands())
+            if (isInLoopValue(Op))
+              In.insert(Op);
+        }
+        if (In.size() != LiveIn[BB].size() || Out.size() != LiveOut[BB].size()) {
+          LiveIn[BB] = std::move(In);
+          LiveOut[BB] = std::move(Out);
+          Changed = true;
+        }
+      }
+    }
+
+    for (BasicBlock *BB : L.blocks()) {
+      SmallPtrSet<Value *, 16> Live(LiveOut[BB].begin(), LiveOut[BB].end());
+      SmallDenseMap<unsigned, unsigned, 4> Count;
+      for (Value *V : Live)
+        ++Count[getClass(V)];
+      auto RecordMax = [&]() {
+        for (auto &[ClassID, N] : Count)
+          MaxInLoop[ClassID] = std::max(MaxInLoop[ClassID], N);
+      };
+      RecordMax();
+      for (Instruction &I : llvm::reverse(*BB)) {
+        if (isa<PHINode>(I))
+          break;
+        if (Live.erase(&I))
+          --Count[getClass(&I)];
+        for (Value *Op : I.operands())
+          if (isInLoopValue(Op) && Live.insert(Op).second)
+            ++Count[getClass(Op)];
+        RecordMax();
+      }
+    }
+  }
+};
+
+// Rewrites the loads and stores of one promoted location into SSA values,
+// and stores the final value in every exit block. MemorySSA is updated for
+// each access that is added or removed.
+class LoopPromoter : public LoadAndStorePromoter {
+  Value *Ptr;
+  Type *Ty;
+  Align Alignment;
+  Loop &L;
+  ArrayRef<BasicBlock *> ExitBlocks;
+  SSAUpdater &SSA;
+  MemorySSAUpdater &MSSAU;
+
+public:
+  LoopPromoter(Value *Ptr, Type *Ty, Align Alignment,
+               ArrayRef<const Instruction *> Insts, SSAUpdater &SSA, Loop &L,
+               ArrayRef<BasicBlock *> ExitBlocks, MemorySSAUpdater &MSSAU)
+      : LoadAndStorePromoter(Insts, SSA, Ptr->getName()), Ptr(Ptr), Ty(Ty),
+        Alignment(Alignment), L(L), ExitBlocks(ExitBlocks), SSA(SSA),
+        MSSAU(MSSAU) {}
+
+  // Loop passes keep LCSSA form: a value from inside the loop reaches the
+  // exit block's store through a phi.
+  Value *getLCSSAValue(Value *V, BasicBlock *ExitBB) {
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I || !L.contains(I->getParent()))
+      return V;
+    auto *PN = PHINode::Create(Ty, pred_size(ExitBB), I->getName() + ".lcssa",
+                               &ExitBB->front());
+    for (BasicBlock *Pred : predecessors(ExitBB))
+      PN->addIncoming(I, Pred);
+    return PN;
+  }
+
+  void doExtraRewritesBeforeFinalDeletion() override {
+    for (BasicBlock *ExitBB : ExitBlocks) {
+      Value *LiveOut =
+          getLCSSAValue(SSA.GetValueInMiddleOfBlock(ExitBB), ExitBB);
+      auto *SI = new StoreInst(LiveOut, Ptr, /*isVolatile=*/false, Alignment,
+                               &*ExitBB->getFirstInsertionPt());
+      MemoryAccess *MA = MSSAU.createMemoryAccessInBB(SI, nullptr, ExitBB,
+                                                      MemorySSA::Beginning);
+      MSSAU.insertDef(cast<MemoryDef>(MA), /*RenameUses=*/true);
+    }
+  }
+
+  void instructionDeleted(Instruction *I) const override {
+    MSSAU.removeMemoryAccess(I);
+  }
+};
+
+// A block added before the loop for -simple-licm-guard. Branch ends with
+// a branch on Cond that goes to Then on the side OnTrue selects; Then
+// holds the guarded instructions and both paths meet in Join, the new
+// preheader, where a phi carries each guarded value.
+struct GuardedBlock {
+  Value *Cond;
+  bool OnTrue;
+  BasicBlock *Branch;
+  BasicBlock *Then;
+  BasicBlock *Join;
+};
+
 struct SimpleLICM : public PassInfoMixin<SimpleLICM> {
   PreservedAnalyses run(Loop &L, LoopAnalysisManager &AM,
                         LoopStandardAnalysisResults &AR,
@@ -39,12 +320,404 @@ struct SimpleLICM : public PassInfoMixin<SimpleLICM> {
       return PreservedAnalyses::all();
     }
 
+    // Loads are only considered when the pass runs in loop-mssa(...)
+    MemorySSA *MSSA = AR.MSSA;
+    std::optional<MemorySSAUpdater> MSSAU;
+    if (MSSA)
+      MSSAU.emplace(MSSA);
+
+    LoopBlocksRPO RPOT(&L);
+    RPOT.perform(&AR.LI);
+
     SmallPtrSet<Instruction *, 8> InvariantSet;
+    if (UseFixedPoint)
+      findInvariantsFixedPoint(L, MSSA, InvariantSet);
+    else
+      findInvariants(L, RPOT, MSSA, InvariantSet);
+
+    SimpleLoopSafetyInfo SafetyInfo;
+    SafetyInfo.computeLoopSafetyInfo(&L);
+
+    std::optional<LoopRegPressure> Pressure;
+    if (RegPressure)
+      Pressure.emplace(L, AR.TTI, InvariantSet);
+    unsigned NumVetoed = 0;
+    SmallVector<GuardedBlock, 2> Guards;
+
+    // Hoist in reverse post-order, so an invariant operand is always moved
+    // before its users. An instruction whose operand had to stay in the
+    // loop stays as well.
+    //
+    // Each exit block once, even if several loop blocks branch to it:
+    // promotion and sinking put one copy in every block of this list.
+    SmallVector<BasicBlock *, 8> ExitBlocks;
+    L.getUniqueExitBlocks(ExitBlocks);
+    SmallVector<Instruction *, 16> ToHoist;
+    for (BasicBlock *BB : RPOT)
+      for (Instruction &I : *BB)
+        if (InvariantSet.count(&I))
+          ToHoist.push_back(&I);
+
+    for (Instruction *I : ToHoist) {
+      if (!L.hasLoopInvariantOperands(I))
+        continue;
+
+      if (auto *LI = dyn_cast<LoadInst>(I)) {
+        // A load moves if it runs on every iteration that reaches an exit,
+        // or if its address can be read early without faulting.
+        bool MustExecute = SafetyInfo.isGuaranteedToExecute(*LI, &DT, &L);
+        if (!MustExecute &&
+            !isSafeToSpeculativelyExecute(LI, Preheader->getTerminator())) {
+          if (GuardedHoist)
+            hoistUnderGuard(*LI, L, AR, MSSAU ? &*MSSAU : nullptr, SafetyInfo,
+                            Preheader, Guards, Pressure);
+          continue;
+        }
+        errs() << "Hoisting: " << *I << "\n";
+        // Metadata such as !noundef only held where the load used to run
+        if (!MustExecute)
+          LI->dropUBImplyingAttrsAndMetadata();
+        LI->moveBefore(Preheader->getTerminator());
+        MSSAU->moveToPlace(cast<MemoryUseOrDef>(MSSA->getMemoryAccess(LI)),
+                           Preheader, MemorySSA::BeforeTerminator);
+        ++NumHoisted;
+        if (Pressure)
+          Pressure->hoisted(*LI);
+        continue;
+      }
+
+      // An instruction that may trap moves as it is if the first iteration
+      // runs it anyway. Otherwise it only moves under a guard, and only if
+      // it is expensive enough to be worth the extra blocks.
+      bool MustExecute = SafetyInfo.isGuaranteedToExecute(*I, &DT, &L);
+      if (!MustExecute && !isSafeToSpeculativelyExecute(I)) {
+        if (GuardedHoist && !isCheapToSpeculate(*I, AR.TTI))
+          hoistUnderGuard(*I, L, AR, MSSAU ? &*MSSAU : nullptr, SafetyInfo,
+                          Preheader, Guards, Pressure);
+        continue;
+      }
+
+      // An instruction from a conditional block runs on every iteration
+      // once hoisted, even where the loop skipped it, so it must be cheap
+      bool Conditional =
+          !MustExecute && !dominatesAllLoopExits(I, ExitBlocks, DT);
+      if (Conditional && !isCheapToSpeculate(*I, AR.TTI))
+        continue;
+      if (Pressure &&
+          shouldKeepInLoop(*I, L, *Pressure, InvariantSet, AR.TTI)) {
+        errs() << "Not hoisting (register pressure): " << *I << "\n";
+        ++NumVetoed;
+        continue;
+      }
+      errs() << "Hoisting: " << *I << "\n";
+      if (Conditional)
+        I->dropUBImplyingAttrsAndMetadata();
+      I->moveBefore(Preheader->getTerminator());
+      ++NumHoisted;
+      if (Pressure)
+        Pressure->hoisted(*I);
+    }
+
+    if (NumVetoed) {
+      errs() << "Register pressure: kept " << NumVetoed
+             << " invariant instruction(s) in the loop\n";
+      NumPressureVetoed += NumVetoed;
+    }
+
+    if (Promote && MSSA && L.hasDedicatedExits()) {
+      SafetyInfo.computeLoopSafetyInfo(&L);
+      promoteLoopAccesses(L, AR.AA, DT, *MSSA, *MSSAU, SafetyInfo, Preheader,
+                          ExitBlocks);
+    }
+
+    if (Sink)
+      sinkToExits(L, RPOT, ExitBlocks);
+
+    if (MSSA && VerifyMemorySSA)
+      MSSA->verifyMemorySSA();
+
+    // Only instructions moved, promoted or sunk, and guard blocks added
+    // before the loop with DominatorTree and LoopInfo updated: the loop
+    // analyses stay valid, and MemorySSA was kept up to date for
+    // loop-mssa(...).
+    PreservedAnalyses PA = getLoopPassPreservedAnalyses();
+    if (MSSA)
+      PA.preserve<MemorySSAAnalysis>();
+    return PA;
+  }
+
+  static bool isCheapToSpeculate(Instruction &I,
+                                 const TargetTransformInfo &TTI) {
+    InstructionCost Cost =
+        TTI.getInstructionCost(&I, TargetTransformInfo::TCK_SizeAndLatency);
+    return Cost.isValid() && Cost <= SpeculateCost;
+  }
+
+  // For -simple-licm-guard: I's block is entered from a branch that is
+  // reached on the first iteration, and nothing before I in its block may
+  // stop execution. The branch either tests a loop invariant condition,
+  // or is the exit test of an unrotated loop: a compare in the header of
+  // header phis and invariants whose other side leaves the loop. Then,
+  // whenever the condition selects I's side on the first iteration, I
+  // runs, so it can run once before the loop under the same condition
+  // (see createGuard for the exit test). Returns the condition and whether
+  // I is on its true side.
+  static std::optional<std::pair<Value *, bool>>
+  getGuardCondition(Instruction &I, Loop &L, DominatorTree &DT,
+                    SimpleLoopSafetyInfo &SafetyInfo) {
+    BasicBlock *BB = I.getParent();
+    BasicBlock *Pred = BB->getSinglePredecessor();
+    if (!Pred || !L.contains(Pred))
+      return std::nullopt;
+    auto *BI = dyn_cast<BranchInst>(Pred->getTerminator());
+    if (!BI || !BI->isConditional() ||
+        BI->getSuccessor(0) == BI->getSuccessor(1) ||
+        !SafetyInfo.isGuaranteedToExecute(*BI, &DT, &L))
+      return std::nullopt;
+    if (!L.isLoopInvariant(BI->getCondition()) &&
+        !isHeaderExitTest(*BI, BB, L))
+      return std::nullopt;
+    for (Instruction &Prev : *BB) {
+      if (&Prev == &I)
+        break;
+      if (!isGuaranteedToTransferExecutionToSuccessor(&Prev))
+        return std::nullopt;
+    }
+    return std::make_pair(BI->getCondition(), BI->getSuccessor(0) == BB);
+  }
+
+  // BI, in the header, leaves the loop unless it goes to BB, and compares
+  // only header phis and loop invariants. Its outcome on the first
+  // iteration is then known before the loop.
+  static bool isHeaderExitTest(BranchInst &BI, BasicBlock *BB, Loop &L) {
+    auto *Cmp = dyn_cast<CmpInst>(BI.getCondition());
+    BasicBlock *Other =
+        BI.getSuccessor(0) == BB ? BI.getSuccessor(1) : BI.getSuccessor(0);
+    if (!Cmp || BI.getParent() != L.getHeader() ||
+        Cmp->getParent() != L.getHeader() || L.contains(Other))
+      return false;
+    return llvm::all_of(Cmp->operands(), [&](Value *Op) {
+      auto *PN = dyn_cast<PHINode>(Op);
+      return L.isLoopInvariant(Op) || (PN && PN->getParent() == L.getHeader());
+    });
+  }
+
+  // Moves I into a guarded block before the loop. Its users in the loop
+  // read it through a phi in the new preheader, which is poison on the
+  // path that skips the guarded block: that path never reaches them.
+  void hoistUnderGuard(Instruction &I, Loop &L,
+                       LoopStandardAnalysisResults &AR,
+                       MemorySSAUpdater *MSSAU,
+                       SimpleLoopSafetyInfo &SafetyInfo,
+                       BasicBlock *&Preheader,
+                       SmallVectorImpl<GuardedBlock> &Guards,
+                       std::optional<LoopRegPressure> &Pressure) {
+    if (I.getType()->isVoidTy())
+      return;
+    auto Guard = getGuardCondition(I, L, AR.DT, SafetyInfo);
+    if (!Guard)
+      return;
+    auto [Cond, OnTrue] = *Guard;
+
+    // Reuse a block for the same condition if I's operands are available
+    // there. Values guarded by it are used directly rather than through
+    // their phis; anything else hoisted into its join block since comes
+    // too late.
+    GuardedBlock *G = nullptr;
+    for (GuardedBlock &Existing : Guards) {
+      if (Existing.Cond != Cond || Existing.OnTrue != OnTrue)
+        continue;
+      if (llvm::all_of(I.operands(), [&](Value *Op) {
+            auto *OpInst = dyn_cast<Instruction>(Op);
+            return !OpInst ||
+                   (isa<PHINode>(OpInst) &&
+                    OpInst->getParent() == Existing.Join) ||
+                   AR.DT.dominates(OpInst, Existing.Then->getTerminator());
+          })) {
+        G = &Existing;
+        break;
+      }
+    }
+    if (!G) {
+      Guards.push_back(createGuard(Cond, OnTrue, L, AR, MSSAU, Preheader));
+      G = &Guards.back();
+    }
+
+    errs() << "Hoisting under guard: " << I << "\n";
+    for (Use &Op : I.operands())
+      if (auto *PN = dyn_cast<PHINode>(Op.get()))
+        if (PN->getParent() == G->Join)
+          Op.set(PN->getIncomingValueForBlock(G->Then));
+    I.moveBefore(G->Then->getTerminator());
+    if (MSSAU)
+      if (MemoryAccess *MA = MSSAU->getMemorySSA()->getMemoryAccess(&I))
+        MSSAU->moveToPlace(cast<MemoryUseOrDef>(MA), G->Then,
+                           MemorySSA::End);
+
+    auto *PN = PHINode::Create(I.getType(), 2, I.getName() + ".guarded",
+                               &G->Join->front());
+    I.replaceAllUsesWith(PN);
+    PN->addIncoming(&I, G->Then);
+    PN->addIncoming(PoisonValue::get(I.getType()), G->Branch);
+    ++NumHoisted;
+    if (Pressure) {
+      Pressure->hoisted(I);
+      Pressure->hoisted(*PN);
+    }
+  }
+
+  // Splits the preheader: it now branches on Cond to a new guarded block,
+  // and both paths meet in a new preheader. A header exit test is not
+  // invariant; it is recomputed before the loop with each header phi
+  // replaced by its value on entry, which gives its first-iteration result.
+  GuardedBlock createGuard(Value *Cond, bool OnTrue, Loop &L,
+                           LoopStandardAnalysisResults &AR,
+                           MemorySSAUpdater *MSSAU, BasicBlock *&Preheader) {
+    DominatorTree &DT = AR.DT;
+    BasicBlock *Branch = Preheader;
+    Value *GuardCond = Cond;
+    if (!L.isLoopInvariant(Cond)) {
+      Instruction *First = cast<CmpInst>(Cond)->clone();
+      for (Use &Op : First->operands())
+        if (auto *PN = dyn_cast<PHINode>(Op.get()))
+          Op.set(PN->getIncomingValueForBlock(Branch));
+      First->setName(Cond->getName() + ".first");
+      First->insertBefore(Branch->getTerminator());
+      GuardCond = First;
+    }
+    BasicBlock *Join = SplitBlock(Branch, Branch->getTerminator(), &DT, &AR.LI,
+                                  MSSAU, "licm.ph");
+    BasicBlock *Then = BasicBlock::Create(Branch->getContext(), "licm.guard",
+                                          Branch->getParent(), Join);
+    BranchInst::Create(Join, Then);
+
+    // The loop branches on Cond on its first iteration anyway. Freezing it
+    // keeps a poison condition from making the earlier branch UB.
+    Instruction *OldTerm = Branch->getTerminator();
+    if (!isGuaranteedNotToBeUndefOrPoison(GuardCond))
+      GuardCond = new FreezeInst(GuardCond, GuardCond->getName() + ".fr",
+                                 OldTerm);
+    BranchInst::Create(OnTrue ? Then : Join, OnTrue ? Join : Then, GuardCond,
+                       Branch);
+    OldTerm->eraseFromParent();
+
+    DT.addNewBlock(Then, Branch);
+    if (Loop *Parent = L.getParentLoop())
+      Parent->addBasicBlockToLoop(Then, AR.LI);
+    if (MSSAU)
+      MSSAU->applyUpdates({{DominatorTree::Insert, Branch, Then},
+                           {DominatorTree::Insert, Then, Join}},
+                          DT);
+
+    Preheader = Join;
+    return {Cond, OnTrue, Branch, Then, Join};
+  }
+
+  // Cost model for -simple-licm-reg-pressure. A cheap instruction that
+  // the loop keeps using stays in the loop, and is recomputed on every
+  // iteration, if hoisting it would need more registers than the target
+  // has: a spill and reload in the loop would cost more than recomputing.
+  // Its invariant users lose an invariant operand and stay in the loop
+  // with it, so I is only kept if everything it pins that way is cheap as
+  // well.
+  static bool shouldKeepInLoop(Instruction &I, Loop &L,
+                               const LoopRegPressure &Pressure,
+                               const SmallPtrSetImpl<Instruction *> &Set,
+                               const TargetTransformInfo &TTI) {
+    auto IsCheap = [&](Instruction &J) {
+      return !J.mayReadOrWriteMemory() &&
+             TTI.getInstructionCost(&J,
+                                    TargetTransformInfo::TCK_SizeAndLatency) <=
+                 TargetTransformInfo::TCC_Basic;
+    };
+    if (!LoopRegPressure::needsRegister(&I) || !IsCheap(I))
+      return false;
+    bool UsedByVariant = llvm::any_of(I.users(), [&](User *U) {
+      auto *UI = cast<Instruction>(U);
+      return L.contains(UI->getParent()) && !Set.count(UI);
+    });
+    if (!UsedByVariant || Pressure.getPressureAfterHoisting(I) <=
+                              Pressure.getBudget(Pressure.getClass(&I)))
+      return false;
+
+    // Invariant users, and theirs, that would stay in the loop with I
+    SmallVector<Instruction *, 8> Worklist{&I};
+    SmallPtrSet<Instruction *, 8> Pinned{&I};
+    while (!Worklist.empty()) {
+      Instruction *Cur = Worklist.pop_back_val();
+      for (User *U : Cur->users()) {
+        auto *UI = cast<Instruction>(U);
+        if (!Set.count(UI) || !Pinned.insert(UI).second)
+          continue;
+        if (!IsCheap(*UI))
+          return false;
+        Worklist.push_back(UI);
+      }
+    }
+    return true;
+  }
+
+  // Instructions that may be invariant: no phi, no terminator and no
+  // memory access, except for loads when MemorySSA is available.
+  static bool isCandidate(const Instruction &I, MemorySSA *MSSA) {
+    if (auto *LI = dyn_cast<LoadInst>(&I))
+      return MSSA && LI->isUnordered();
+    return !I.isTerminator() && !I.mayReadOrWriteMemory() && !isa<PHINode>(I);
+  }
+
+  // For a candidate whose operands are all invariant: a load is invariant
+  // too if nothing in the loop may write the location it reads. The
+  // walker uses AA to skip stores that cannot alias the load, also through
+  // the MemoryPhi of the loop header.
+  static bool hasInvariantMemory(Instruction &I, Loop &L, MemorySSA *MSSA) {
+    if (!isa<LoadInst>(I))
+      return true;
+    MemoryAccess *Clobber =
+        MSSA->getWalker()->getClobberingMemoryAccess(MSSA->getMemoryAccess(&I));
+    return MSSA->isLiveOnEntryDef(Clobber) || !L.contains(Clobber->getBlock());
+  }
+
+  // True if V is defined outside L or is already known to be invariant.
+  static bool isInvariantOperand(Value *V, Loop &L,
+                                 const SmallPtrSetImpl<Instruction *> &Set) {
+    // Constants and arguments are always loop invariant
+    if (isa<Constant>(V) || isa<Argument>(V))
+      return true;
+    auto *OpInst = dyn_cast<Instruction>(V);
+    if (!OpInst)
+      return false; // unknown operand type
+    return !L.contains(OpInst->getParent()) || Set.count(OpInst);
+  }
+
+  // Single-pass algorithm to identify loop invariant instructions.
+  //
+  // The loop body is visited in reverse post-order. A candidate's
+  // operands are either phis, which are never invariant, or instructions
+  // that dominate it, and those come earlier in reverse post-order. So
+  // when an instruction is visited, every in-loop operand it depends on
+  // has already been decided, and one visit per instruction finds the
+  // same set as rescanning the loop until nothing changes.
+  void findInvariants(Loop &L, LoopBlocksRPO &RPOT, MemorySSA *MSSA,
+                      SmallPtrSetImpl<Instruction *> &InvariantSet) {
+    for (BasicBlock *BB : RPOT) {
+      for (Instruction &I : *BB) {
+        if (!isCandidate(I, MSSA))
+          continue;
+        if (llvm::all_of(I.operands(), [&](Use &U) {
+              return isInvariantOperand(U.get(), L, InvariantSet);
+            }) &&
+            hasInvariantMemory(I, L, MSSA))
+          InvariantSet.insert(&I);
+      }
+    }
+  }
+
+  // Reference implementation: rescan every loop instruction until no new
+  // invariant instruction is found.
+  void findInvariantsFixedPoint(Loop &L, MemorySSA *MSSA,
+                                SmallPtrSetImpl<Instruction *> &InvariantSet) {
     bool Change = true;
 
-    // Worklist algorithm to identify loop invariant instructions
-    /*************************************/
-    
     // Keep iterating until no new invariant instructions are found
     while (Change) {
       Change = false;
@@ -57,16 +730,9 @@ struct SimpleLICM : public PassInfoMixin<SimpleLICM> {
           if (InvariantSet.count(&I))
             continue;
           
-          // Skip terminators
-          if (I.isTerminator()) 
-            continue;
-
-          // Skip memory operations (loads, stores, etc.)
-          if (I.mayReadOrWriteMemory())
-            continue;
-          
-          // Skip phi instructions
-          if (isa<PHINode>(I))
+          // Skip terminators, phi instructions and memory operations
+          // other than loads
+          if (!isCandidate(I, MSSA))
             continue;
           
           // Check if all operands are loop invariant
@@ -106,29 +772,230 @@ struct SimpleLICM : public PassInfoMixin<SimpleLICM> {
           }
           
           // If all operands are loop invariant, mark this instruction as invariant
-          if (AllOperandsInvariant) {
+          if (AllOperandsInvariant && hasInvariantMemory(I, L, MSSA)) {
             InvariantSet.insert(&I);
             Change = true; // We found a new invariant instruction
           }
         }
       }
     }
-    /*************************************/ 
+  }
 
-    // Actually hoist the instructions
-    for (Instruction *I : InvariantSet) {
-      if (isSafeToSpeculativelyExecute(I) && dominatesAllLoopExits(I, &L, DT)) {
-        errs() << "Hoisting: " << *I << "\n";
-        I->moveBefore(Preheader->getTerminator());
+  // Scalar promotion of locations the loop reads and writes at an invariant
+  // address, e.g. C[i][j] += ... in an inner loop or a global counter.
+  //
+  // A location is promoted when every access to it in the loop is a simple
+  // load or store of one type through the same pointer, AA shows that no
+  // other access in the loop (from MemorySSA's access lists) may read or
+  // write it, and one of its stores runs on every iteration. The store
+  // makes it safe to load the location in the preheader and to store it on
+  // every exit. The loop then carries the value in a phi instead. If the
+  // loop may throw, unwinding skips the exit stores, so the location must
+  // also be one nobody can read after unwinding.
+  void promoteLoopAccesses(Loop &L, AAResults &AA, DominatorTree &DT,
+                           MemorySSA &MSSA, MemorySSAUpdater &MSSAU,
+                           SimpleLoopSafetyInfo &SafetyInfo,
+                           BasicBlock *Preheader,
+                           ArrayRef<BasicBlock *> ExitBlocks) {
+    // Addresses written in the loop, in program order
+    SmallSetVector<Value *, 8> Candidates;
+    for (BasicBlock *BB : L.blocks())
+      for (Instruction &I : *BB)
+        if (auto *SI = dyn_cast<StoreInst>(&I))
+          if (SI->isSimple() && L.isLoopInvariant(SI->getPointerOperand()))
+            Candidates.insert(SI->getPointerOperand());
+
+    const DataLayout &DL = Preheader->getModule()->getDataLayout();
+    for (Value *Ptr : Candidates) {
+      SmallVector<Instruction *, 8> Accesses;
+      Type *Ty = nullptr;
+      Align Alignment;
+      bool HasMustExecuteStore = false;
+      if (!collectPromotableAccesses(L, Ptr, AA, DT, MSSA, SafetyInfo, DL,
+                                     Accesses, Ty, Alignment,
+                                     HasMustExecuteStore) ||
+          !HasMustExecuteStore)
+        continue;
+
+      errs() << "Promoting: " << *Ptr << "\n";
+      SmallVector<PHINode *, 16> NewPHIs;
+      SSAUpdater SSA(&NewPHIs);
+      SmallVector<const Instruction *, 8> ConstAccesses(Accesses.begin(),
+                                                       Accesses.end());
+      LoopPromoter Promoter(Ptr, Ty, Alignment, ConstAccesses, SSA, L,
+                            ExitBlocks, MSSAU);
+
+      auto *PreheaderLoad =
+          new LoadInst(Ty, Ptr, Ptr->getName() + ".promoted",
+                       /*isVolatile=*/false, Alignment,
+                       Preheader->getTerminator());
+      auto *NewUse = cast<MemoryUse>(MSSAU.createMemoryAccessInBB(
+          PreheaderLoad, nullptr, Preheader, MemorySSA::End));
+      MSSAU.insertUse(NewUse, /*RenameUses=*/true);
+      SSA.AddAvailableValue(Preheader, PreheaderLoad);
+
+      Promoter.run(Accesses);
+
+      // The preheader load is dead if every path stores before reading
+      if (PreheaderLoad->use_empty()) {
+        MSSAU.removeMemoryAccess(PreheaderLoad);
+        PreheaderLoad->eraseFromParent();
+      }
+    }
+  }
+
+  // Collects the loads and stores of Ptr in the loop. Fails if another
+  // access in the loop may touch the location, or if the accesses to Ptr
+  // are not all simple and of one type.
+  bool collectPromotableAccesses(Loop &L, Value *Ptr, AAResults &AA,
+                                 DominatorTree &DT, MemorySSA &MSSA,
+                                 SimpleLoopSafetyInfo &SafetyInfo,
+                                 const DataLayout &DL,
+                                 SmallVectorImpl<Instruction *> &Accesses,
+                                 Type *&Ty, Align &Alignment,
+                                 bool &HasMustExecuteStore) {
+    std::optional<MemoryLocation> Loc;
+    for (BasicBlock *BB : L.blocks()) {
+      auto *BlockAccesses = MSSA.getBlockAccesses(BB);
+      if (!BlockAccesses)
+        continue;
+      for (const MemoryAccess &MA : *BlockAccesses) {
+        auto *MUD = dyn_cast<MemoryUseOrDef>(&MA);
+        if (!MUD)
+          continue; // MemoryPhi
+        Instruction *I = MUD->getMemoryInst();
+
+        if (getLoadStorePointerOperand(I) == Ptr) {
+          Type *AccessTy = getLoadStoreType(I);
+          bool Simple = isa<LoadInst>(I) ? cast<LoadInst>(I)->isSimple()
+                                         : cast<StoreInst>(I)->isSimple();
+          if (!Simple || (Ty && AccessTy != Ty))
+            return false;
+          if (!Ty) {
+            Ty = AccessTy;
+            Alignment = getLoadStoreAlignment(I);
+            Loc = MemoryLocation(
+                Ptr, LocationSize::precise(DL.getTypeStoreSize(Ty)));
+          }
+          Alignment = std::min(Alignment, getLoadStoreAlignment(I));
+          if (isa<StoreInst>(I) && SafetyInfo.isGuaranteedToExecute(*I, &DT, &L))
+            HasMustExecuteStore = true;
+          Accesses.push_back(I);
+        }
+      }
+    }
+    if (!Ty)
+      return false;
+
+    // A call that may throw need not show up in MemorySSA (readnone), so
+    // check the loop's blocks rather than the accesses
+    if (SafetyInfo.anyBlockMayThrow()) {
+      const Value *Obj = getUnderlyingObject(Ptr);
+      bool RequiresNoCaptureBeforeUnwind;
+      if (!isNotVisibleOnUnwind(Obj, RequiresNoCaptureBeforeUnwind))
+        return false;
+      if (RequiresNoCaptureBeforeUnwind &&
+          PointerMayBeCaptured(Obj, /*ReturnCaptures=*/true))
+        return false;
+    }
+
+    // Every other memory access in the loop must leave the location alone
+    for (BasicBlock *BB : L.blocks()) {
+      auto *BlockAccesses = MSSA.getBlockAccesses(BB);
+      if (!BlockAccesses)
+        continue;
+      for (const MemoryAccess &MA : *BlockAccesses) {
+        auto *MUD = dyn_cast<MemoryUseOrDef>(&MA);
+        if (!MUD || getLoadStorePointerOperand(MUD->getMemoryInst()) == Ptr)
+          continue;
+        if (isModOrRefSet(AA.getModRefInfo(MUD->getMemoryInst(), *Loc)))
+          return false;
       }
     }
+    return true;
+  }
 
-    return PreservedAnalyses::none();
+  // Sinks instructions whose results are only used after the loop into
+  // the exit blocks that use them, one copy per exit block. Blocks are
+  // visited in post-order and instructions bottom-up, so an operand that
+  // only fed a sunk instruction is visited after it and can follow it out.
+  void sinkToExits(Loop &L, LoopBlocksRPO &RPOT,
+                   ArrayRef<BasicBlock *> ExitBlocks) {
+    SmallPtrSet<BasicBlock *, 4> Exits(ExitBlocks.begin(), ExitBlocks.end());
+    SmallVector<BasicBlock *, 16> Blocks(RPOT.begin(), RPOT.end());
+    for (BasicBlock *BB : llvm::reverse(Blocks))
+      for (Instruction &I : llvm::make_early_inc_range(llvm::reverse(*BB)))
+        if (canSinkToExits(I, Exits))
+          sinkToExits(I, L);
   }
 
-  bool dominatesAllLoopExits(Instruction *I, Loop *L, DominatorTree &DT) {
-    SmallVector<BasicBlock *, 8> ExitBlocks;
-    L->getExitBlocks(ExitBlocks);
+  // In LCSSA form a value used after the loop only reaches its users
+  // through phis in the exit blocks. I can be sunk if all of its users are
+  // such phis and it neither touches memory nor has other side effects, so
+  // computing it once on exit, from the operands of the last iteration,
+  // gives the value the phi would have received.
+  static bool canSinkToExits(Instruction &I,
+                             const SmallPtrSetImpl<BasicBlock *> &Exits) {
+    if (I.use_empty() || I.isTerminator() || isa<PHINode>(I) || I.isEHPad() ||
+        isa<AllocaInst>(I) || I.getType()->isTokenTy() ||
+        I.mayReadOrWriteMemory() || I.mayHaveSideEffects())
+      return false;
+    if (auto *CB = dyn_cast<CallBase>(&I))
+      if (CB->isConvergent())
+        return false;
+    return llvm::all_of(I.users(), [&](User *U) {
+      auto *PN = dyn_cast<PHINode>(U);
+      return PN && Exits.count(PN->getParent()) && isLCSSAPhiOf(*PN, &I);
+    });
+  }
+
+  static bool isLCSSAPhiOf(PHINode &PN, Value *V) {
+    return llvm::all_of(PN.incoming_values(),
+                        [&](Value *In) { return In == V; });
+  }
+
+  // Replaces each exit phi of I with a copy of I in that exit block. The
+  // copy's in-loop operands are taken through LCSSA phis of their own.
+  void sinkToExits(Instruction &I, Loop &L) {
+    errs() << "Sinking: " << I << "\n";
+    SmallSetVector<PHINode *, 4> Phis;
+    for (User *U : I.users())
+      Phis.insert(cast<PHINode>(U));
+
+    SmallDenseMap<BasicBlock *, Instruction *, 4> Copies;
+    for (PHINode *PN : Phis) {
+      BasicBlock *ExitBB = PN->getParent();
+      Instruction *&Copy = Copies[ExitBB];
+      if (!Copy) {
+        Copy = I.clone();
+        Copy->setName(I.getName() + ".le");
+        Copy->insertBefore(&*ExitBB->getFirstInsertionPt());
+        for (Use &Op : Copy->operands())
+          if (auto *OpInst = dyn_cast<Instruction>(Op.get()))
+            if (L.contains(OpInst->getParent()))
+              Op.set(getOrCreateLCSSAPhi(OpInst, ExitBB));
+      }
+      PN->replaceAllUsesWith(Copy);
+      PN->eraseFromParent();
+    }
+    I.eraseFromParent();
+  }
+
+  // An operand of I dominates I, and I reached ExitBB's phis from every
+  // predecessor, so the operand is available at the end of each of them.
+  static PHINode *getOrCreateLCSSAPhi(Instruction *I, BasicBlock *ExitBB) {
+    for (PHINode &PN : ExitBB->phis())
+      if (isLCSSAPhiOf(PN, I))
+        return &PN;
+    auto *PN = PHINode::Create(I->getType(), pred_size(ExitBB),
+                               I->getName() + ".lcssa", &ExitBB->front());
+    for (BasicBlock *Pred : predecessors(ExitBB))
+      PN->addIncoming(I, Pred);
+    return PN;
+  }
+
+  bool dominatesAllLoopExits(Instruction *I, ArrayRef<BasicBlock *> ExitBlocks,
+                             DominatorTree &DT) {
     for (BasicBlock *EB : ExitBlocks) {
       if (!DT.dominates(I, EB))
         return false;
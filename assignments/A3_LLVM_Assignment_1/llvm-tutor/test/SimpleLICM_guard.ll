@@ -0,0 +1,219 @@
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop-mssa(simple-licm)' -verify-memoryssa -S %s 2>/dev/null | FileCheck %s
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop-mssa(simple-licm)' -simple-licm-guard -verify-memoryssa -S %s 2>/dev/null | FileCheck %s --check-prefix=GUARD
+
+; A cheap invariant that cannot trap is hoisted from a conditional block:
+; computing it on iterations that skipped it costs less than computing it
+; in the loop.
+define void @speculate(ptr %out, i32 %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %odd = and i32 %i, 1
+  %isodd = icmp ne i32 %odd, 0
+  br i1 %isodd, label %then, label %latch
+
+then:
+  %m = mul i32 %a, 3
+  %oi = getelementptr inbounds i32, ptr %out, i32 %i
+  store i32 %m, ptr %oi, align 4
+  br label %latch
+
+latch:
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @speculate
+; CHECK:       entry:
+; CHECK-NEXT:    %m = mul i32 %a, 3
+; CHECK-NEXT:    br label %loop
+
+; The divide and the load may trap, and run only when an invariant branch
+; in the loop selects them. With -simple-licm-guard each moves to a block
+; before the loop that runs under the same condition, and the loop reads
+; it through a phi. The add using the divide is cheap and follows it out.
+define void @guarded(ptr noalias %out, ptr noalias %p, i32 %a, i32 %b, i32 %n) {
+entry:
+  %nz = icmp ne i32 %b, 0
+  %nonnull = icmp ne ptr %p, null
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  br i1 %nz, label %div, label %next
+
+div:
+  %q = sdiv i32 %a, %b
+  %q1 = add i32 %q, 1
+  %oi = getelementptr inbounds i32, ptr %out, i32 %i
+  store i32 %q1, ptr %oi, align 4
+  br label %next
+
+next:
+  br i1 %nonnull, label %ld, label %latch
+
+ld:
+  %v = load i32, ptr %p, align 4
+  %oj = getelementptr inbounds i32, ptr %out, i32 %i
+  store i32 %v, ptr %oj, align 4
+  br label %latch
+
+latch:
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @guarded
+; CHECK:       div:
+; CHECK-NEXT:    %q = sdiv i32 %a, %b
+; CHECK:       ld:
+; CHECK-NEXT:    %v = load i32, ptr %p, align 4
+
+; GUARD-LABEL: @guarded
+; GUARD:       entry:
+; GUARD:         %nz.fr = freeze i1 %nz
+; GUARD-NEXT:    br i1 %nz.fr, label %licm.guard, label %licm.ph
+; GUARD:       licm.guard:
+; GUARD-NEXT:    %q = sdiv i32 %a, %b
+; GUARD-NEXT:    br label %licm.ph
+; GUARD:       licm.ph:
+; GUARD-NEXT:    %q.guarded = phi i32 [ %q, %licm.guard ], [ poison, %entry ]
+; GUARD-NEXT:    %q1 = add i32 %q.guarded, 1
+; GUARD-NEXT:    %nonnull.fr = freeze i1 %nonnull
+; GUARD-NEXT:    br i1 %nonnull.fr, label %[[LDGUARD:.*]], label %[[PH:.*]]
+; GUARD:       [[LDGUARD]]:
+; GUARD-NEXT:    %v = load i32, ptr %p, align 4
+; GUARD:       [[PH]]:
+; GUARD-NEXT:    %v.guarded = phi i32 [ %v, %[[LDGUARD]] ], [ poison, %licm.ph ]
+; GUARD-NEXT:    br label %loop
+; GUARD:       div:
+; GUARD-NEXT:    %oi = getelementptr inbounds i32, ptr %out, i32 %i
+; GUARD-NEXT:    store i32 %q1, ptr %oi, align 4
+; GUARD:       ld:
+; GUARD-NEXT:    %oj = getelementptr inbounds i32, ptr %out, i32 %i
+; GUARD-NEXT:    store i32 %v.guarded, ptr %oj, align 4
+
+; Not guarded: the branch depends on %i, so the divide may not run on the
+; first iteration even when it runs later
+define void @variant(ptr %out, i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %c = icmp sgt i32 %i, 3
+  br i1 %c, label %div, label %latch
+
+div:
+  %q = udiv i32 %a, %b
+  %oi = getelementptr inbounds i32, ptr %out, i32 %i
+  store i32 %q, ptr %oi, align 4
+  br label %latch
+
+latch:
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; GUARD-LABEL: @variant
+; GUARD:       div:
+; GUARD-NEXT:    %q = udiv i32 %a, %b
+
+; An unrotated for-loop: the body runs on the first iteration exactly when
+; 0 < %n. The exit test is not invariant, so the guard recomputes it with
+; %i replaced by its start value.
+define void @unrotated(ptr noalias %out, i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %body ]
+  %cmp = icmp slt i32 %i, %n
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %q = udiv i32 %a, %b
+  %oi = getelementptr inbounds i32, ptr %out, i32 %i
+  store i32 %q, ptr %oi, align 4
+  %i.next = add i32 %i, 1
+  br label %loop
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @unrotated
+; CHECK:       body:
+; CHECK-NEXT:    %q = udiv i32 %a, %b
+
+; GUARD-LABEL: @unrotated
+; GUARD:       entry:
+; GUARD-NEXT:    %cmp.first = icmp slt i32 0, %n
+; GUARD-NEXT:    %cmp.first.fr = freeze i1 %cmp.first
+; GUARD-NEXT:    br i1 %cmp.first.fr, label %licm.guard, label %licm.ph
+; GUARD:       licm.guard:
+; GUARD-NEXT:    %q = udiv i32 %a, %b
+; GUARD:       licm.ph:
+; GUARD-NEXT:    %q.guarded = phi i32 [ %q, %licm.guard ], [ poison, %entry ]
+; GUARD:       body:
+; GUARD-NEXT:    %oi = getelementptr inbounds i32, ptr %out, i32 %i
+; GUARD-NEXT:    store i32 %q.guarded, ptr %oi, align 4
+
+; %r is behind the same condition as %q, but it uses %q1, which was
+; hoisted into the new preheader after the guard block was made. %q1 is
+; not available in that block, so %r gets a guard of its own.
+define void @guard_reuse(ptr noalias %out, i32 %a, i32 %b, i32 %n) {
+entry:
+  %nz = icmp ne i32 %b, 0
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  br i1 %nz, label %div, label %latch
+
+div:
+  %q = sdiv i32 %a, %b
+  %q1 = add i32 %q, 1
+  %r = sdiv i32 %a, %q1
+  %oi = getelementptr inbounds i32, ptr %out, i32 %i
+  store i32 %r, ptr %oi, align 4
+  br label %latch
+
+latch:
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; GUARD-LABEL: @guard_reuse
+; GUARD:       licm.guard:
+; GUARD-NEXT:    %q = sdiv i32 %a, %b
+; GUARD:       licm.ph:
+; GUARD-NEXT:    %q.guarded = phi i32 [ %q, %licm.guard ], [ poison, %entry ]
+; GUARD-NEXT:    %q1 = add i32 %q.guarded, 1
+; GUARD-NEXT:    [[FR:%nz.fr[0-9]*]] = freeze i1 %nz
+; GUARD-NEXT:    br i1 [[FR]], label %[[RGUARD:.*]], label %[[PH:.*]]
+; GUARD:       [[RGUARD]]:
+; GUARD-NEXT:    %r = sdiv i32 %a, %q1
+; GUARD:       [[PH]]:
+; GUARD-NEXT:    %r.guarded = phi i32 [ %r, %[[RGUARD]] ], [ poison, %licm.ph ]
+; GUARD:       div:
+; GUARD-NEXT:    %oi = getelementptr inbounds i32, ptr %out, i32 %i
+; GUARD-NEXT:    store i32 %r.guarded, ptr %oi, align 4
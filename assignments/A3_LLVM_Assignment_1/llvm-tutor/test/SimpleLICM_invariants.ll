@@ -0,0 +1,42 @@
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop(simple-licm)' -S %s 2>/dev/null | FileCheck %s
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop(simple-licm)' -simple-licm-fixed-point -S %s 2>/dev/null | FileCheck %s
+
+; Both invariant searches find the same instructions, and all of them are
+; hoisted. %d may trap, but it is in the header, which runs at least once
+; whenever the loop is entered, so computing it before the loop is safe.
+; %e, which uses it, follows it out.
+
+define i32 @chain(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %m = mul i32 %a, 3
+  %d = sdiv i32 %a, %b
+  br label %latch
+
+latch:
+  %m2 = add i32 %m, 7
+  %e = add i32 %d, 1
+  %m3 = xor i32 %m2, %m
+  %k = add i32 %m3, %e
+  %i.next = add i32 %i, %k
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %i.next
+}
+
+; CHECK-LABEL: @chain
+; CHECK:       entry:
+; CHECK-DAG:     %m = mul i32 %a, 3
+; CHECK-DAG:     %d = sdiv i32 %a, %b
+; CHECK-DAG:     %m2 = add i32 %m, 7
+; CHECK-DAG:     %e = add i32 %d, 1
+; CHECK-DAG:     %m3 = xor i32 %m2, %m
+; CHECK-DAG:     %k = add i32 %m3, %e
+; CHECK:         br label %loop
+; CHECK:       latch:
+; CHECK-NEXT:    %i.next = add i32 %i, %k
@@ -0,0 +1,99 @@
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop-mssa(simple-licm)' -verify-memoryssa -S %s 2>/dev/null | FileCheck %s
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop(simple-licm)' -S %s 2>/dev/null | FileCheck %s --check-prefix=NOMSSA
+
+; Loads are hoisted only with MemorySSA, when no store in the loop may
+; write the loaded location, and when the load either runs on every
+; iteration or reads memory that is known to be dereferenceable.
+
+%struct.S = type { i32, i32 }
+
+; The field is read on every iteration and %out cannot alias it: the load
+; and the multiply that uses it are hoisted.
+define i32 @field(ptr %s, ptr noalias %out, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %f = getelementptr inbounds %struct.S, ptr %s, i64 0, i32 1
+  %v = load i32, ptr %f, align 4
+  %w = mul i32 %v, 3
+  %o = getelementptr inbounds i32, ptr %out, i32 %i
+  store i32 %w, ptr %o, align 4
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %w
+}
+
+; CHECK-LABEL: @field
+; CHECK:       entry:
+; CHECK-NEXT:    %f = getelementptr inbounds %struct.S, ptr %s, i64 0, i32 1
+; CHECK-NEXT:    %v = load i32, ptr %f, align 4
+; CHECK-NEXT:    %w = mul i32 %v, 3
+; CHECK-NEXT:    br label %loop
+
+; NOMSSA-LABEL: @field
+; NOMSSA:       loop:
+; NOMSSA:         %v = load i32, ptr %f, align 4
+
+; The store through %out may write *%s.
+define i32 @clobbered(ptr %s, ptr %out, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32, ptr %s, align 4
+  %o = getelementptr inbounds i32, ptr %out, i32 %i
+  store i32 %v, ptr %o, align 4
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %v
+}
+
+; CHECK-LABEL: @clobbered
+; CHECK:       loop:
+; CHECK:         %v = load i32, ptr %s, align 4
+
+; Both loads run only when %b is set. %q is dereferenceable, so its load
+; is hoisted and loses its !noundef. %p may be null, so its load stays.
+define i32 @conditional(ptr %p, ptr dereferenceable(4) align 4 %q, i32 %n, i1 %b) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %latch ]
+  br i1 %b, label %then, label %latch
+
+then:
+  %x = load i32, ptr %p, align 4
+  %y = load i32, ptr %q, align 4, !noundef !0
+  %xy = add i32 %x, %y
+  br label %latch
+
+latch:
+  %t = phi i32 [ %xy, %then ], [ 0, %loop ]
+  %acc.next = add i32 %acc, %t
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %acc.next
+}
+
+!0 = !{}
+
+; CHECK-LABEL: @conditional
+; CHECK:       entry:
+; CHECK-NEXT:    %y = load i32, ptr %q, align 4{{$}}
+; CHECK-NEXT:    br label %loop
+; CHECK:       then:
+; CHECK-NEXT:    %x = load i32, ptr %p, align 4
@@ -0,0 +1,197 @@
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop-mssa(simple-licm)' -simple-licm-promote -verify-memoryssa -S %s 2>/dev/null | FileCheck %s
+
+; Scalar promotion: a location read and written at an invariant address on
+; every iteration is loaded once before the loop, carried in a phi and
+; stored once in each exit block.
+
+@counter = internal global i32 0
+
+; C[j] += a[k]: promoted
+define void @acc(ptr noalias %c, ptr noalias %a, i32 %n, i32 %j) {
+entry:
+  %cj = getelementptr inbounds i32, ptr %c, i32 %j
+  br label %loop
+
+loop:
+  %k = phi i32 [ 0, %entry ], [ %k.next, %loop ]
+  %ak = getelementptr inbounds i32, ptr %a, i32 %k
+  %v = load i32, ptr %ak, align 4
+  %old = load i32, ptr %cj, align 4
+  %new = add i32 %old, %v
+  store i32 %new, ptr %cj, align 4
+  %k.next = add i32 %k, 1
+  %cmp = icmp slt i32 %k.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @acc
+; CHECK:       entry:
+; CHECK:         %cj.promoted = load i32, ptr %cj, align 4
+; CHECK:       loop:
+; CHECK-NEXT:    [[ACC:%.*]] = phi i32 [ %cj.promoted, %entry ], [ %new, %loop ]
+; CHECK-NOT:     store
+; CHECK:         %new = add i32 [[ACC]], %v
+; CHECK:       exit:
+; CHECK-NEXT:    %new.lcssa = phi i32 [ %new, %loop ]
+; CHECK-NEXT:    store i32 %new.lcssa, ptr %cj, align 4
+
+; A global counter with two exits gets a store in each
+define i32 @count(ptr noalias %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %k = phi i32 [ 0, %entry ], [ %k.next, %latch ]
+  %ak = getelementptr inbounds i32, ptr %a, i32 %k
+  %v = load i32, ptr %ak, align 4
+  %old = load i32, ptr @counter, align 4
+  %new = add i32 %old, 1
+  store i32 %new, ptr @counter, align 4
+  %isneg = icmp slt i32 %v, 0
+  br i1 %isneg, label %early, label %latch
+
+latch:
+  %k.next = add i32 %k, 1
+  %cmp = icmp slt i32 %k.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+early:
+  ret i32 -1
+
+exit:
+  ret i32 0
+}
+
+; CHECK-LABEL: @count
+; CHECK:       entry:
+; CHECK-NEXT:    %counter.promoted = load i32, ptr @counter, align 4
+; CHECK:       early:
+; CHECK-NEXT:    %new.lcssa = phi i32 [ %new, %loop ]
+; CHECK-NEXT:    store i32 %new.lcssa, ptr @counter, align 4
+; CHECK:       exit:
+; CHECK-NEXT:    [[LIVEOUT:%.*]] = phi i32 [ %new, %latch ]
+; CHECK-NEXT:    store i32 [[LIVEOUT]], ptr @counter, align 4
+
+; Not promoted: the load through %a may read *%c
+define void @may_alias(ptr %c, ptr %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %k = phi i32 [ 0, %entry ], [ %k.next, %loop ]
+  %ak = getelementptr inbounds i32, ptr %a, i32 %k
+  %v = load i32, ptr %ak, align 4
+  %old = load i32, ptr %c, align 4
+  %new = add i32 %old, %v
+  store i32 %new, ptr %c, align 4
+  %k.next = add i32 %k, 1
+  %cmp = icmp slt i32 %k.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @may_alias
+; CHECK:       loop:
+; CHECK:         %old = load i32, ptr %c, align 4
+; CHECK:         store i32 %new, ptr %c, align 4
+
+; Not promoted: the store does not run on every iteration, so storing on
+; exit could write memory the loop never wrote
+define void @conditional(ptr noalias %c, ptr noalias %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %k = phi i32 [ 0, %entry ], [ %k.next, %latch ]
+  %ak = getelementptr inbounds i32, ptr %a, i32 %k
+  %v = load i32, ptr %ak, align 4
+  %pos = icmp sgt i32 %v, 2
+  br i1 %pos, label %then, label %latch
+
+then:
+  %old = load i32, ptr %c, align 4
+  %new = add i32 %old, %v
+  store i32 %new, ptr %c, align 4
+  br label %latch
+
+latch:
+  %k.next = add i32 %k, 1
+  %cmp = icmp slt i32 %k.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @conditional
+; CHECK:       then:
+; CHECK-NEXT:    %old = load i32, ptr %c, align 4
+; CHECK:         store i32 %new, ptr %c, align 4
+
+; Not promoted: @may_throw can unwind out of the loop after the store,
+; and the caller would then miss the updates to @counter. Being readnone,
+; the call has no MemorySSA access.
+declare i32 @may_throw(i32) readnone
+
+define void @unwind(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %k = phi i32 [ 0, %entry ], [ %k.next, %latch ]
+  %old = load i32, ptr @counter, align 4
+  %new = add i32 %old, 1
+  store i32 %new, ptr @counter, align 4
+  br label %latch
+
+latch:
+  %r = call i32 @may_throw(i32 %k)
+  %k.next = add i32 %k, 1
+  %cmp = icmp slt i32 %k.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @unwind
+; CHECK-NOT:     promoted
+; CHECK:       loop:
+; CHECK:         %old = load i32, ptr @counter, align 4
+; CHECK:         store i32 %new, ptr @counter, align 4
+
+; Two loop blocks branch to the same exit block: it gets one store, fed by
+; one phi with an incoming value from each
+define void @shared_exit(ptr noalias %c, ptr noalias %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %k = phi i32 [ 0, %entry ], [ %k.next, %latch ]
+  %ak = getelementptr inbounds i32, ptr %a, i32 %k
+  %v = load i32, ptr %ak, align 4
+  %old = load i32, ptr %c, align 4
+  %new = add i32 %old, %v
+  store i32 %new, ptr %c, align 4
+  %isneg = icmp slt i32 %v, 0
+  br i1 %isneg, label %exit, label %latch
+
+latch:
+  %k.next = add i32 %k, 1
+  %cmp = icmp slt i32 %k.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @shared_exit
+; CHECK:       exit:
+; CHECK-NEXT:    [[LIVEOUT:%.*]] = phi i32 [ %new, %latch ], [ %new, %loop ]
+; CHECK-NEXT:    store i32 [[LIVEOUT]], ptr %c, align 4
+; CHECK-NEXT:    ret void
@@ -0,0 +1,98 @@
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop(simple-licm)' -simple-licm-reg-pressure -simple-licm-reg-budget=7 -S %s 2>%t.err | FileCheck %s
+; RUN: FileCheck %s --check-prefix=REPORT < %t.err
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop(simple-licm)' -simple-licm-reg-pressure -simple-licm-reg-budget=16 -S %s 2>/dev/null | FileCheck %s --check-prefix=ROOMY
+
+; %a, %b and %n are live across the loop, and the variant part needs a few
+; registers of its own. With 7 registers only %c1 fits: the other cheap
+; adds stay in the loop. %d is a divide, too expensive to recompute, and is
+; hoisted anyway. With 16 registers everything is hoisted.
+define i32 @many(i32 %n, i32 %a, i32 %b) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %c1 = add i32 %a, 1
+  %c2 = add i32 %a, 2
+  %c3 = add i32 %b, 3
+  %c4 = add i32 %b, 4
+  %d = sdiv i32 %a, 7
+  %x1 = mul i32 %i, %c1
+  %x2 = xor i32 %x1, %c2
+  %x3 = sub i32 %x2, %c3
+  %x4 = or i32 %x3, %c4
+  %x5 = add i32 %x4, %d
+  %acc.next = add i32 %acc, %x5
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %r = phi i32 [ %acc.next, %loop ]
+  ret i32 %r
+}
+
+; CHECK-LABEL: @many
+; CHECK:       entry:
+; CHECK-NEXT:    %c1 = add i32 %a, 1
+; CHECK-NEXT:    %d = sdiv i32 %a, 7
+; CHECK-NEXT:    br label %loop
+; CHECK:       loop:
+; CHECK:         %c2 = add i32 %a, 2
+; CHECK-NEXT:    %c3 = add i32 %b, 3
+; CHECK-NEXT:    %c4 = add i32 %b, 4
+
+; REPORT: Hoisting: {{.*}}%c1 =
+; REPORT: Not hoisting (register pressure): {{.*}}%c2 =
+; REPORT: Not hoisting (register pressure): {{.*}}%c3 =
+; REPORT: Not hoisting (register pressure): {{.*}}%c4 =
+; REPORT: Hoisting: {{.*}}%d =
+; REPORT: Register pressure: kept 3 invariant instruction(s) in the loop
+
+; ROOMY-LABEL: @many
+; ROOMY:       entry:
+; ROOMY-NEXT:    %c1 = add i32 %a, 1
+; ROOMY-NEXT:    %c2 = add i32 %a, 2
+; ROOMY-NEXT:    %c3 = add i32 %b, 3
+; ROOMY-NEXT:    %c4 = add i32 %b, 4
+; ROOMY-NEXT:    %d = sdiv i32 %a, 7
+
+; As @many, but the divide uses %c3. Keeping %c3 in the loop would keep
+; the divide there too, so %c3 is hoisted despite the pressure.
+define i32 @pinned(i32 %n, i32 %a, i32 %b) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %c1 = add i32 %a, 1
+  %c2 = add i32 %a, 2
+  %c3 = add i32 %b, 3
+  %c4 = add i32 %b, 4
+  %d = sdiv i32 %c3, 7
+  %x1 = mul i32 %i, %c1
+  %x2 = xor i32 %x1, %c2
+  %x3 = sub i32 %x2, %c3
+  %x4 = or i32 %x3, %c4
+  %x5 = add i32 %x4, %d
+  %acc.next = add i32 %acc, %x5
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %r = phi i32 [ %acc.next, %loop ]
+  ret i32 %r
+}
+
+; CHECK-LABEL: @pinned
+; CHECK:       entry:
+; CHECK-NEXT:    %c1 = add i32 %a, 1
+; CHECK-NEXT:    %c2 = add i32 %a, 2
+; CHECK-NEXT:    %c3 = add i32 %b, 3
+; CHECK-NEXT:    %d = sdiv i32 %c3, 7
+; CHECK-NEXT:    br label %loop
+; CHECK:       loop:
+; CHECK:         %c4 = add i32 %b, 4
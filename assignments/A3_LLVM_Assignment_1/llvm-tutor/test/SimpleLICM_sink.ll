@@ -0,0 +1,115 @@
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop(simple-licm)' -S %s 2>/dev/null | FileCheck %s
+; RUN: opt -load-pass-plugin %shlibdir/libSimpleLICM%shlibext -passes='loop(simple-licm)' -simple-licm-sink=false -S %s 2>/dev/null | FileCheck %s --check-prefix=NOSINK
+
+; Instructions whose results are only used after the loop are computed once
+; in the exit blocks instead of on every iteration.
+
+; %scaled and %avg only feed the exit: both move, and %sum.next reaches
+; them through a new LCSSA phi
+define i32 @after(ptr %a, i32 %n, i32 %m) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %ai = getelementptr inbounds i32, ptr %a, i32 %i
+  %v = load i32, ptr %ai, align 4
+  %sum.next = add i32 %sum, %v
+  %scaled = mul i32 %sum.next, %m
+  %avg = sdiv i32 %scaled, %n
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %avg.lcssa = phi i32 [ %avg, %loop ]
+  ret i32 %avg.lcssa
+}
+
+; CHECK-LABEL: @after
+; CHECK:       loop:
+; CHECK-NOT:     %scaled
+; CHECK-NOT:     %avg
+; CHECK:       exit:
+; CHECK-NEXT:    %sum.next.lcssa = phi i32 [ %sum.next, %loop ]
+; CHECK-NEXT:    %scaled.le = mul i32 %sum.next.lcssa, %m
+; CHECK-NEXT:    %avg.le = sdiv i32 %scaled.le, %n
+; CHECK-NEXT:    ret i32 %avg.le
+
+; NOSINK-LABEL: @after
+; NOSINK:       loop:
+; NOSINK:         %avg = sdiv i32 %scaled, %n
+; NOSINK:       exit:
+; NOSINK-NEXT:    %avg.lcssa = phi i32 [ %avg, %loop ]
+
+; %off is used after both exits: each exit gets its own copy
+define i32 @two_exits(ptr %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %ai = getelementptr inbounds i32, ptr %a, i32 %i
+  %v = load i32, ptr %ai, align 4
+  %off = shl i32 %i, 2
+  %isneg = icmp slt i32 %v, 0
+  br i1 %isneg, label %found, label %latch
+
+latch:
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %done
+
+found:
+  %off.found = phi i32 [ %off, %loop ]
+  ret i32 %off.found
+
+done:
+  %off.done = phi i32 [ %off, %latch ]
+  %r = sub i32 0, %off.done
+  ret i32 %r
+}
+
+; CHECK-LABEL: @two_exits
+; CHECK:       loop:
+; CHECK-NOT:     shl
+; CHECK:       found:
+; CHECK-NEXT:    [[I1:%.*]] = phi i32 [ %i, %loop ]
+; CHECK-NEXT:    [[OFF1:%.*]] = shl i32 [[I1]], 2
+; CHECK-NEXT:    ret i32 [[OFF1]]
+; CHECK:       done:
+; CHECK-NEXT:    [[I2:%.*]] = phi i32 [ %i, %latch ]
+; CHECK-NEXT:    [[OFF2:%.*]] = shl i32 [[I2]], 2
+; CHECK-NEXT:    %r = sub i32 0, [[OFF2]]
+
+; Not sunk: %x is also used in the loop, and the load may read memory
+; written by the store of a later iteration
+define i32 @stays(ptr %a, ptr %p, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %x = mul i32 %i, 3
+  %ai = getelementptr inbounds i32, ptr %a, i32 %i
+  store i32 %x, ptr %ai, align 4
+  %last = load i32, ptr %p, align 4
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %x.lcssa = phi i32 [ %x, %loop ]
+  %last.lcssa = phi i32 [ %last, %loop ]
+  %r = add i32 %x.lcssa, %last.lcssa
+  ret i32 %r
+}
+
+; CHECK-LABEL: @stays
+; CHECK:       loop:
+; CHECK:         %x = mul i32 %i, 3
+; CHECK:         %last = load i32, ptr %p, align 4
+; CHECK:       exit:
+; CHECK-NEXT:    %x.lcssa = phi i32 [ %x, %loop ]
+; CHECK-NEXT:    %last.lcssa = phi i32 [ %last, %loop ]
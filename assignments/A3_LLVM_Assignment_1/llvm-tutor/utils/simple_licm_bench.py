@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""Compile-time benchmark for SimpleLICM's invariant search.
+
+Generates a function with one large loop whose body is spread over a
+chain of blocks, mixing instructions that only use loop-invariant values
+with instructions that use the induction variable. Each instruction
+takes an operand from the last few values of its kind, so invariant
+instructions form long chains. The module is run through
+loop(simple-licm) twice: with the single-pass search and with
+-simple-licm-fixed-point, the rescan-until-nothing-changes search it
+replaced. Both must produce the same module.
+
+Times are the SimpleLICM rows of -time-passes, so parsing and printing
+the module are not included. Hoisting, and the "Hoisting:" line printed
+for each hoisted instruction, costs the same in both runs, so a small
+--invariant-share measures mostly the search.
+
+Usage:
+    python3 utils/simple_licm_bench.py --plugin build/lib/libSimpleLICM.so
+    python3 utils/simple_licm_bench.py --plugin build/lib/libSimpleLICM.so \
+        --sizes 10000,40000 --blocks 64 --invariant-share 0.3
+"""
+
+import argparse
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+OPS = ["add", "sub", "mul", "xor", "and", "or", "shl"]
+# "0.0123 ( 45.6%)": the last one on a -time-passes row is the wall time
+TIME = re.compile(r"([\d.]+) \(\s*[\d.]+%\)")
+
+
+def gen_module(num_insts, num_blocks, invariant_share, rng):
+    lines = ["define i64 @kernel(i64 %n, i64 %a, i64 %b) {",
+             "entry:",
+             "  br label %body0",
+             "body0:",
+             "  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]",
+             "  %acc = phi i64 [ 0, %entry ], [ %acc.next, %latch ]"]
+    invariant = ["%a", "%b"]
+    variant = ["%i", "%acc"]
+    per_block = max(1, num_insts // num_blocks)
+    block = 0
+
+    for k in range(num_insts):
+        if k and k % per_block == 0 and block + 1 < num_blocks:
+            block += 1
+            lines += [f"  br label %body{block}", f"body{block}:"]
+        op = rng.choice(OPS)
+        lhs = rng.choice(invariant[-4:])
+        if rng.random() < invariant_share:
+            rhs = rng.choice(invariant[-8:] + [str(rng.randrange(1, 64))])
+            pool = invariant
+        else:
+            rhs = rng.choice(variant[-8:])
+            pool = variant
+        if op == "shl":
+            rhs = str(rng.randrange(1, 8))
+            if pool is variant:
+                lhs = rng.choice(variant[-4:])
+        lines.append(f"  %v{k} = {op} i64 {lhs}, {rhs}")
+        pool.append(f"%v{k}")
+
+    lines += ["  br label %latch",
+              "latch:",
+              f"  %acc.next = add i64 %acc, {variant[-1]}",
+              "  %i.next = add i64 %i, 1",
+              "  %cond = icmp slt i64 %i.next, %n",
+              "  br i1 %cond, label %body0, label %exit",
+              "exit:",
+              f"  %res = add i64 %acc.next, {invariant[-1]}",
+              "  ret i64 %res",
+              "}",
+              ""]
+    return "\n".join(lines)
+
+
+def run_opt(opt, plugin, src, dst, extra):
+    """Runs loop(simple-licm), returns the pass's wall time in seconds."""
+    cmd = [opt] + extra + [f"-load-pass-plugin={plugin}",
+                           "-passes=loop(simple-licm)", "-time-passes",
+                           src, "-S", "-o", dst]
+    res = subprocess.run(cmd, stdout=subprocess.DEVNULL,
+                         stderr=subprocess.PIPE, text=True)
+    if res.returncode != 0:
+        sys.exit(f"opt failed ({res.returncode}): {' '.join(cmd)}\n"
+                 f"{res.stderr[-2000:]}")
+    total = 0.0
+    for line in res.stderr.splitlines():
+        if line.rstrip().endswith("SimpleLICM"):
+            times = TIME.findall(line)
+            if times:
+                total += float(times[-1])
+    return total
+
+
+def count_hoisted(path):
+    """Instructions between the entry label and the loop's first block."""
+    with open(path) as f:
+        text = f.read()
+    entry = text.split("entry:", 1)[1].split("body0:", 1)[0]
+    return sum(1 for line in entry.splitlines() if " = " in line)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--opt", default="opt")
+    ap.add_argument("--plugin", default="./lib/libSimpleLICM.so")
+    ap.add_argument("--sizes", default="2500,10000,40000",
+                    help="loop body instructions, comma separated")
+    ap.add_argument("--blocks", type=int, default=16,
+                    help="blocks the loop body is split into")
+    ap.add_argument("--invariant-share", type=float, default=0.05,
+                    help="share of instructions that only use invariants")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--opt-flags", default="",
+                    help="extra opt flags for both runs")
+    args = ap.parse_args()
+    extra = args.opt_flags.split()
+
+    print(f"{'insts':>8} {'hoisted':>8} {'fixed-point (s)':>16} "
+          f"{'one pass (s)':>13} {'speedup':>8}  output")
+    failed = False
+    with tempfile.TemporaryDirectory() as tmpdir:
+        for size in (int(s) for s in args.sizes.split(",")):
+            rng = random.Random(args.seed)
+            src = os.path.join(tmpdir, f"licm_{size}.ll")
+            with open(src, "w") as f:
+                f.write(gen_module(size, args.blocks, args.invariant_share,
+                                   rng))
+
+            out_fixed = os.path.join(tmpdir, "fixed.ll")
+            out_work = os.path.join(tmpdir, "work.ll")
+            t_fixed = run_opt(args.opt, args.plugin, src, out_fixed,
+                              extra + ["-simple-licm-fixed-point"])
+            t_work = run_opt(args.opt, args.plugin, src, out_work, extra)
+
+            with open(out_fixed) as a, open(out_work) as b:
+                same = a.read() == b.read()
+            failed |= not same
+            speedup = t_fixed / t_work if t_work else float("inf")
+            print(f"{size:>8} {count_hoisted(out_work):>8} "
+                  f"{t_fixed:>16.4f} {t_work:>13.4f} {speedup:>7.2f}x  "
+                  f"{'identical' if same else 'DIFFERENT'}")
+
+    if failed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
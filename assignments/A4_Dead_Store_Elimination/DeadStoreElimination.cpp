@@ -5,26 +5,197 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Operator.h"
 
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryLocation.h"
 #include "llvm/Analysis/MemorySSA.h"
 #include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
 #include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
 
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO/FunctionAttrs.h"
+#include "llvm/Transforms/IPO/InferFunctionAttrs.h"
+#include "llvm/Transforms/Utils/Local.h"
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 
 using namespace llvm;
 
+#define DEBUG_TYPE "dse-mssa"
+
+STATISTIC(NumDeadStores, "The # of dead stores removed");
+STATISTIC(NumNoopStores, "The # of no-op stores removed");
+STATISTIC(NumShrunkStores, "The # of partially overwritten stores shrunk");
+STATISTIC(NumMergedRuns, "The # of adjacent store runs merged");
+STATISTIC(NumTrimmedIntrinsics, "The # of memory intrinsics trimmed");
+STATISTIC(NumSunkStores, "The # of loop stores sunk to the exit");
+STATISTIC(NumRejectNoPriorWrite, "Killers rejected: no prior write");
+STATISTIC(NumRejectNotStore, "Killers rejected: clobber is not a store");
+STATISTIC(NumRejectVolatile, "Killers rejected: clobber is volatile/atomic");
+STATISTIC(NumRejectNotMustAlias, "Killers rejected: not MustAlias");
+STATISTIC(NumRejectInterveningUse, "Killers rejected: intervening use");
+STATISTIC(NumRejectNotPostDom, "Killers rejected: not post-dominated");
+STATISTIC(NumRejectBudget, "Killers rejected: sweep step budget");
+STATISTIC(NumRejectAtomic, "Killers rejected: atomic ordering");
+
+static cl::opt<bool> DSEPathSensitive(
+    "dse-path-sensitive", cl::init(false),
+    cl::desc("DSE: follow MemoryPhi merges and remove stores that are "
+             "overwritten on every path, not just by one later store"));
+
+static cl::opt<bool> DSEPartialOverwrite(
+    "dse-partial-overwrite", cl::init(false),
+    cl::desc("DSE: track byte ranges per base pointer to remove stores covered "
+             "by several later stores, shrink partially covered constant "
+             "stores and merge adjacent narrow constant stores"));
+
+static cl::opt<bool> DSEEndOfLifetime(
+    "dse-end-of-lifetime", cl::init(false),
+    cl::desc("DSE: remove stores to non-escaping allocas and heap objects "
+             "that nothing reads before return, lifetime.end or free, and "
+             "stores to any object that every path frees before reading"));
+
+static cl::opt<bool> DSENoopStores(
+    "dse-noop-stores", cl::init(false),
+    cl::desc("DSE: remove stores that write back the value just loaded from "
+             "the same location, with no clobber in between"));
+
+static cl::opt<bool> DSEMemIntrinsics(
+    "dse-mem-intrinsics", cl::init(false),
+    cl::desc("DSE: treat memset/memcpy/memmove with constant length as "
+             "killers and candidates; delete or trim them when overwritten"));
+
+static cl::opt<bool> DSELoopSink(
+    "dse-loop-sink", cl::init(false),
+    cl::desc("DSE: replace a store to a loop-invariant location that the "
+             "loop never reads with one store of the final value on exit"));
+
+static cl::opt<bool> DSEAtomicStores(
+    "dse-atomic-stores", cl::init(false),
+    cl::desc("DSE: let unordered and monotonic atomic stores kill and be "
+             "killed by a later store to the same location that is at least "
+             "as strongly ordered"));
+
+static cl::opt<bool> DSEBackwardSweep(
+    "dse-backward-sweep", cl::init(false),
+    cl::desc("DSE: find stores killed by the next store with one backward "
+             "sweep over MemorySSA instead of a walker query per store"));
+
+static cl::opt<unsigned> DSESweepBudget(
+    "dse-sweep-budget", cl::init(100),
+    cl::desc("DSE: MemoryDefs a pending overwrite is carried past in the "
+             "backward sweep before it stops (matches -memssa-check-limit)"));
+
 namespace {
 
+// A later store the backward sweep is carrying up the def chain, looking for
+// the earlier store it overwrites. Base/Offset let stores to disjoint bytes
+// of the same object be told apart without asking alias analysis.
+struct PendingKill {
+  StoreInst *Killer;
+  MemoryLocation Loc;
+  const Value *Base;
+  int64_t Offset;
+  unsigned Steps;
+};
+
+// Sorted, disjoint [Begin, End) byte ranges relative to one base pointer.
+// Used by the partial-overwrite phase to remember which bytes a later store
+// in the block overwrites before anything reads them.
+class ByteIntervals {
+  SmallVector<std::pair<int64_t, int64_t>, 4> Ranges;
+
+public:
+  void add(int64_t Begin, int64_t End) {
+    SmallVector<std::pair<int64_t, int64_t>, 4> Merged;
+    for (auto &R : Ranges) {
+      if (R.second < Begin || R.first > End) {
+        Merged.push_back(R);
+        continue;
+      }
+      Begin = std::min(Begin, R.first);
+      End = std::max(End, R.second);
+    }
+    Merged.push_back({Begin, End});
+    llvm::sort(Merged);
+    Ranges = std::move(Merged);
+  }
+
+  void remove(int64_t Begin, int64_t End) {
+    SmallVector<std::pair<int64_t, int64_t>, 4> Left;
+    for (auto &R : Ranges) {
+      if (R.second <= Begin || R.first >= End) {
+        Left.push_back(R);
+        continue;
+      }
+      if (R.first < Begin) Left.push_back({R.first, Begin});
+      if (R.second > End)  Left.push_back({End, R.second});
+    }
+    Ranges = std::move(Left);
+  }
+
+  // Part of [Begin, End) *not* covered. Returns false if that part is empty
+  // or not one contiguous range.
+  bool uncovered(int64_t Begin, int64_t End, int64_t &UBegin,
+                 int64_t &UEnd) const {
+    UBegin = Begin;
+    UEnd = End;
+    for (auto &R : Ranges) {
+      if (R.second <= UBegin || R.first >= UEnd)
+        continue;
+      if (R.first <= UBegin)
+        UBegin = std::max(UBegin, R.second);
+      else if (R.second >= UEnd)
+        UEnd = std::min(UEnd, R.first);
+      else
+        return false; // hole in the middle
+    }
+    return UBegin < UEnd;
+  }
+
+  bool covers(int64_t Begin, int64_t End) const {
+    for (auto &R : Ranges)
+      if (R.first <= Begin && R.second >= End)
+        return true;
+    return false;
+  }
+};
+
 struct DeadStoreEliminationPass : PassInfoMixin<DeadStoreEliminationPass> {
 
+  // Missed remark for a store that does not kill the write it clobbers.
+  // Every rule has its own remark name and counter, so a remark file (or
+  // -stats) shows which rule blocks the most eliminations. The remark is
+  // only built when remarks are enabled.
+  static void reportRejected(OptimizationRemarkEmitter &ORE, Statistic &Counter,
+                             StringRef Name, Instruction *Killer,
+                             StringRef Reason) {
+    ++Counter;
+    ORE.emit([&]() {
+      return OptimizationRemarkMissed(DEBUG_TYPE, Name, Killer)
+             << "store does not kill an earlier store: " << Reason;
+    });
+  }
+
   // identify removable stores 
   static bool isRemovableStore(const Instruction *I) {
     const auto *SI = dyn_cast<StoreInst>(I);
@@ -34,6 +205,89 @@ struct DeadStoreEliminationPass : PassInfoMixin<DeadStoreEliminationPass> {
     return true;
   }
 
+  // Stores the single-killer rule works on: the removable ones, and with
+  // -dse-atomic-stores also unordered and monotonic atomic stores. Volatile,
+  // acquire/release and seq_cst stores are never killed and never kill.
+  static bool isKillCandidate(const Instruction *I) {
+    if (isRemovableStore(I))
+      return true;
+    const auto *SI = dyn_cast<StoreInst>(I);
+    if (!DSEAtomicStores || !SI || SI->isVolatile())
+      return false;
+    return SI->getOrdering() == AtomicOrdering::Unordered ||
+           SI->getOrdering() == AtomicOrdering::Monotonic;
+  }
+
+  // May Later kill Earlier as far as atomics go? An atomic store can only be
+  // replaced by one at least as strongly ordered. Another thread may also
+  // read an atomic store legally, so nothing between the two may let it
+  // synchronize with this one: both must sit in one block with no fence,
+  // read-modify-write, ordered load or store, or call that is not nosync
+  // in between.
+  static bool atomicOrderingAllowsKill(const StoreInst *Earlier,
+                                       const StoreInst *Later) {
+    if (!Earlier->isAtomic())
+      return true;
+    if (isStrongerThan(Earlier->getOrdering(), Later->getOrdering()))
+      return false;
+    if (Earlier->getParent() != Later->getParent())
+      return false;
+    for (const Instruction *I = Earlier->getNextNode(); I != Later;
+         I = I->getNextNode()) {
+      if (isa<FenceInst>(I) || isa<AtomicRMWInst>(I) ||
+          isa<AtomicCmpXchgInst>(I))
+        return false;
+      if (const auto *LI = dyn_cast<LoadInst>(I))
+        if (isStrongerThanMonotonic(LI->getOrdering()))
+          return false;
+      if (const auto *SI = dyn_cast<StoreInst>(I))
+        if (isStrongerThanMonotonic(SI->getOrdering()))
+          return false;
+      if (const auto *CB = dyn_cast<CallBase>(I))
+        if (!CB->hasFnAttr(Attribute::NoSync) && !isMemoryMarker(I) &&
+            !isa<DbgInfoIntrinsic>(I))
+          return false;
+    }
+    return true;
+  }
+
+  // Could I read Loc? For calls AA uses the callee's memory effects
+  // (readnone, argmemonly with the actual arguments, inaccessiblememonly),
+  // so a helper call that cannot reach Loc is not a read. A call that may
+  // unwind hands memory to the caller's handler, so it reads everything but
+  // the function's own allocas. AAType is AAResults or BatchAAResults.
+  template <typename AAType>
+  static bool instMayRead(const Instruction *I, const MemoryLocation &Loc,
+                          AAType &AA) {
+    if (I->mayThrow() && !isa<AllocaInst>(getUnderlyingObject(Loc.Ptr)))
+      return true;
+    return isRefSet(AA.getModRefInfo(I, Loc));
+  }
+
+  // Does a MemoryUse hanging off Def (a read between Def and the next def)
+  // possibly read Loc?
+  template <typename AAType>
+  static bool hasAliasingUse(const MemoryAccess *Def, const MemoryLocation &Loc,
+                             AAType &AA) {
+    for (const User *U : Def->users()) {
+      const auto *MU = dyn_cast<MemoryUse>(U);
+      if (!MU)
+        continue;
+      const Instruction *UserI = MU->getMemoryInst();
+
+      // If the use is a load, check alias against the store location.
+      if (const auto *LI = dyn_cast_or_null<LoadInst>(UserI)) {
+        MemoryLocation LoadLoc = MemoryLocation::get(LI);
+        if (AA.alias(LoadLoc, Loc) != AliasResult::NoAlias)
+          return true; // intervening read of the same/may alias location
+      } else if (UserI && instMayRead(UserI, Loc, AA)) {
+        // Other kinds of MemoryUse (e.g., calls modeled as uses)
+        return true;
+      }
+    }
+    return false;
+  }
+
   // --- Helper: walk the MemorySSA chain between two MemoryDefs and see if
   //             there’s any intervening read of the earlier store’s location.
   //
@@ -41,8 +295,10 @@ struct DeadStoreEliminationPass : PassInfoMixin<DeadStoreEliminationPass> {
   // Later   = the later  MemoryDef (the "killer" store)
   //
   // We start from Later and walk defining access edges backward until we reach
-  // Earlier (or we bail). If we encounter a MemoryUse that aliases the location
-  // written by Earlier, we report an intervening use -> cannot DSE.
+  // Earlier (or we bail). Loads are MemoryUses hanging off the defs of that
+  // chain, not part of it, so for every def we pass (Earlier included) we look
+  // at its MemoryUse users. If one aliases the location written by Earlier,
+  // we report an intervening use -> cannot DSE.
   //
   // Notes:
   //  * If we cross a MemoryPhi we bail (paths merged).
@@ -61,22 +317,18 @@ struct DeadStoreEliminationPass : PassInfoMixin<DeadStoreEliminationPass> {
       MA = MD->getDefiningAccess();
 
     while (MA && MA != Earlier) {
-      if (const auto *MU = dyn_cast<MemoryUse>(MA)) {
-        const Instruction *UserI = MU->getMemoryInst();
-
-        // If the use is a load, check alias against the earlier store location.
-        if (const auto *LI = dyn_cast_or_null<LoadInst>(UserI)) {
-          MemoryLocation LoadLoc = MemoryLocation::get(LI);
-          if (AA.alias(LoadLoc, EarlierLoc) != AliasResult::NoAlias)
-            return true; // intervening read of the same/may alias location
-        } else {
-          // Other kinds of MemoryUse (e.g., calls modeled as uses) 
-          return true;
-        }
-      } else if (isa<MemoryPhi>(MA)) {
+      if (isa<MemoryPhi>(MA)) {
         // Merged flows
         return true;
       }
+      if (hasAliasingUse(MA, EarlierLoc, AA))
+        return true;
+
+      // The walker skips defs that only *read* the location (a memcpy from
+      // it, a call taking it as an argument); those are uses too.
+      if (const auto *MD = dyn_cast<MemoryDef>(MA))
+        if (instMayRead(MD->getMemoryInst(), EarlierLoc, AA))
+          return true;
 
       if (const auto *MD2 = dyn_cast<MemoryDef>(MA)) {
         MA = MD2->getDefiningAccess();
@@ -85,20 +337,874 @@ struct DeadStoreEliminationPass : PassInfoMixin<DeadStoreEliminationPass> {
       }
     }
 
+    // Reads of Earlier itself sit between it and the next def.
+    if (MA == Earlier && hasAliasingUse(Earlier, EarlierLoc, AA))
+      return true;
+
     // If we cleanly reached Earlier without finding a conflicting MemoryUse
     return false;
   }
 
+  // Marker intrinsics MemorySSA models as defs but its walker never reports
+  // as clobbers.
+  static bool isMemoryMarker(const Instruction *I) {
+    const auto *II = dyn_cast<IntrinsicInst>(I);
+    if (!II)
+      return false;
+    switch (II->getIntrinsicID()) {
+    case Intrinsic::invariant_start:
+    case Intrinsic::invariant_end:
+    case Intrinsic::assume:
+    case Intrinsic::experimental_noalias_scope_decl:
+    case Intrinsic::pseudoprobe:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  // --- Backward sweep: the killer loop in run() without a walker query and
+  //     a chain re-walk per store.
+  //
+  // MemoryDefs are visited in reverse RPO, so every def is seen after all
+  // defs that hang below it in the def chain. Each removable store becomes a
+  // PendingKill and is handed to its defining access. At each def a pending
+  // store either
+  //  * stops there, because the def may write its location (what the walker
+  //    would have returned) or its step budget ran out; the def is dead if it
+  //    is an exact overwrite with no read of it and the killer post-dominates,
+  //  * or moves on up, unless the def or a MemoryUse of it may read the
+  //    location (the checks hasInterveningUseMSSA does hop by hop).
+  // A MemoryPhi or liveOnEntry ends every pending store, as in the walker
+  // based loop. Alias queries go through one BatchAAResults, which caches
+  // them per location pair.
+  static void sweepBackward(Function &F, MemorySSA &MSSA, AAResults &AA,
+                            PostDominatorTree &PDT,
+                            OptimizationRemarkEmitter &ORE,
+                            SmallPtrSetImpl<Instruction *> &Dead) {
+    const DataLayout &DL = F.getParent()->getDataLayout();
+    BatchAAResults BAA(AA);
+
+    // Unreachable blocks only have liveOnEntry as a defining access.
+    SmallVector<MemoryDef *, 32> Defs;
+    ReversePostOrderTraversal<Function *> RPOT(&F);
+    for (BasicBlock *BB : RPOT)
+      for (auto &I : *BB)
+        if (auto *MA = MSSA.getMemoryAccess(&I))
+          if (auto *MD = dyn_cast<MemoryDef>(MA))
+            Defs.push_back(MD);
+
+    DenseMap<MemoryAccess *, SmallVector<PendingKill, 4>> Arriving;
+    unsigned NumSteps = 0;
+
+    for (MemoryDef *D : llvm::reverse(Defs)) {
+      SmallVector<PendingKill, 4> Pending;
+      auto It = Arriving.find(D);
+      if (It != Arriving.end()) {
+        Pending = std::move(It->second);
+        Arriving.erase(It);
+      }
+
+      Instruction *Inst = D->getMemoryInst();
+      StoreInst *SI = isKillCandidate(Inst) ? cast<StoreInst>(Inst) : nullptr;
+      MemoryLocation Loc;
+      const Value *Base = nullptr;
+      int64_t Offset = 0;
+      if (SI) {
+        Loc = MemoryLocation::get(SI);
+        Base = GetPointerBaseWithConstantOffset(SI->getPointerOperand(),
+                                                Offset, DL);
+      }
+
+      SmallVector<PendingKill, 4> Up;
+      bool IsDead = false;
+      for (PendingKill &P : Pending) {
+        ++NumSteps;
+        bool OverBudget = ++P.Steps >= DSESweepBudget;
+        bool Clobbers;
+        if (OverBudget || isMemoryMarker(Inst))
+          Clobbers = OverBudget;
+        else if (SI && Base == P.Base && Loc.Size.isPrecise() &&
+                 P.Loc.Size.isPrecise() &&
+                 (Offset + (int64_t)Loc.Size.getValue() <= P.Offset ||
+                  P.Offset + (int64_t)P.Loc.Size.getValue() <= Offset))
+          Clobbers = false; // disjoint bytes of the same object
+        else
+          Clobbers = isModSet(BAA.getModRefInfo(Inst, P.Loc));
+
+        if (Clobbers) {
+          if (IsDead)
+            continue;
+          bool Exact = SI && BAA.alias(P.Loc, Loc) == AliasResult::MustAlias &&
+                       P.Loc.Size == Loc.Size;
+          if (!Exact && OverBudget)
+            reportRejected(ORE, NumRejectBudget, "StepBudget", P.Killer,
+                           "sweep step budget reached");
+          else if (!SI && isa<StoreInst>(Inst))
+            reportRejected(ORE, NumRejectVolatile, "ClobberVolatile",
+                           P.Killer, "previous store is volatile/atomic");
+          else if (!SI)
+            reportRejected(ORE, NumRejectNotStore, "ClobberNotStore",
+                           P.Killer, "previous write is not a store");
+          else if (!Exact)
+            reportRejected(ORE, NumRejectNotMustAlias, "NotMustAlias",
+                           P.Killer, "not MustAlias and same-size");
+          else if (!atomicOrderingAllowsKill(SI, P.Killer))
+            reportRejected(ORE, NumRejectAtomic, "AtomicOrdering", P.Killer,
+                           "atomic ordering does not allow the kill");
+          else if (hasAliasingUse(D, Loc, BAA))
+            reportRejected(ORE, NumRejectInterveningUse, "InterveningUse",
+                           P.Killer, "intervening use (MSSA chain)");
+          else if (!PDT.dominates(P.Killer->getParent(), SI->getParent()))
+            reportRejected(ORE, NumRejectNotPostDom, "NotPostDominated",
+                           P.Killer, "does not post-dominate the earlier store");
+          else
+            IsDead = true;
+          if (IsDead)
+            ORE.emit([&]() {
+              return OptimizationRemark(DEBUG_TYPE, "DeadStore", Inst)
+                     << "store is overwritten by "
+                     << ore::NV("Killer", P.Killer) << " before any read";
+            });
+          continue;
+        }
+        if (hasAliasingUse(D, P.Loc, BAA) || instMayRead(Inst, P.Loc, BAA)) {
+          reportRejected(ORE, NumRejectInterveningUse, "InterveningUse",
+                         P.Killer, "intervening use (MSSA chain)");
+          continue;
+        }
+        Up.push_back(P);
+      }
+
+      if (IsDead)
+        Dead.insert(Inst);
+
+      if (SI)
+        Up.push_back({SI, Loc, Base, Offset, 0});
+      MemoryAccess *Parent = D->getDefiningAccess();
+      if (!isa<MemoryDef>(Parent) || MSSA.isLiveOnEntryDef(Parent)) {
+        // A MemoryPhi or the function entry: the walker has no single prior
+        // write to offer either.
+        for (PendingKill &P : Up)
+          reportRejected(ORE, NumRejectNoPriorWrite, "NoPriorWrite", P.Killer,
+                         "no prior write to the location");
+        continue;
+      }
+      if (!Up.empty())
+        Arriving[Parent].append(Up.begin(), Up.end());
+    }
+
+    ORE.emit([&]() {
+      return OptimizationRemarkAnalysis(DEBUG_TYPE, "BackwardSweep",
+                                        DiagnosticLocation(F.getSubprogram()),
+                                        &F.getEntryBlock())
+             << "backward sweep took " << ore::NV("Steps", NumSteps)
+             << " steps";
+    });
+  }
+
+  // Upper bound on the MemoryAccesses one path-sensitive query may visit,
+  // so huge functions cannot make the pass quadratic.
+  static constexpr unsigned PathScanLimit = 256;
+
+  // Could the instruction behind this access observe the bytes at Loc?
+  static bool mayReadLocation(const MemoryAccess *MA, const MemoryLocation &Loc,
+                              AAResults &AA) {
+    if (const auto *MU = dyn_cast<MemoryUse>(MA)) {
+      if (const auto *LI = dyn_cast_or_null<LoadInst>(MU->getMemoryInst()))
+        return AA.alias(MemoryLocation::get(LI), Loc) != AliasResult::NoAlias;
+      // Other kinds of MemoryUse (e.g., calls modeled as uses)
+      return instMayRead(MU->getMemoryInst(), Loc, AA);
+    }
+    if (const auto *MD = dyn_cast<MemoryDef>(MA)) {
+      // Non-atomic stores (volatile included) only write. Calls are judged
+      // by their memory effects. Volatile loads, ordered atomics and fences
+      // may read or publish the value.
+      const Instruction *I = MD->getMemoryInst();
+      if (isa<CallBase>(I))
+        return instMayRead(I, Loc, AA);
+      const auto *SI = dyn_cast_or_null<StoreInst>(I);
+      return !SI || SI->isAtomic();
+    }
+    return false;
+  }
+
+  // Is V a call to malloc/calloc/operator new?
+  static bool isHeapAllocation(const Value *V, const TargetLibraryInfo &TLI) {
+    const auto *CB = dyn_cast<CallBase>(V);
+    LibFunc LF;
+    if (!CB || !TLI.getLibFunc(*CB, LF))
+      return false;
+    return LF == LibFunc_malloc || LF == LibFunc_calloc ||
+           LF == LibFunc_Znwm || LF == LibFunc_Znam;
+  }
+
+  // An object nobody can look at once this function returns: a local alloca
+  // or a heap allocation whose address never escapes (not stored, not
+  // returned, only passed to nocapture parameters).
+  static bool isInvisibleAfterReturn(const Value *Obj,
+                                     const TargetLibraryInfo &TLI) {
+    if (!isa<AllocaInst>(Obj) && !isHeapAllocation(Obj, TLI))
+      return false;
+    return !PointerMayBeCaptured(Obj, /*ReturnCaptures=*/true);
+  }
+
+  // Is I a free() or operator delete? Returns the pointer whose block it
+  // releases. realloc() is not one: when it fails it returns null and the
+  // old block, contents included, stays valid.
+  static const Value *getFreedPointer(const Instruction *I,
+                                      const TargetLibraryInfo &TLI) {
+    const auto *CB = dyn_cast<CallBase>(I);
+    LibFunc LF;
+    if (!CB || !TLI.getLibFunc(*CB, LF))
+      return nullptr;
+    switch (LF) {
+    case LibFunc_free:
+    case LibFunc_ZdlPv:   // operator delete(void*)
+    case LibFunc_ZdaPv:   // operator delete[](void*)
+    case LibFunc_ZdlPvm:  // sized delete
+    case LibFunc_ZdaPvm:
+      return CB->getArgOperand(0);
+    default:
+      return nullptr;
+    }
+  }
+
+  // Does I end the lifetime of Obj: lifetime.end on Obj or free/delete of
+  // Obj?
+  static bool endsLifetimeOf(const Instruction *I, const Value *Obj,
+                             const TargetLibraryInfo &TLI) {
+    if (const auto *II = dyn_cast<IntrinsicInst>(I)) {
+      if (II->getIntrinsicID() != Intrinsic::lifetime_end)
+        return false;
+      // The object pointer is the last argument.
+      return getUnderlyingObject(II->getArgOperand(II->arg_size() - 1)) == Obj;
+    }
+    const Value *Freed = getFreedPointer(I, TLI);
+    return Freed && getUnderlyingObject(Freed) == Obj;
+  }
+
+  // Does Ptr name the same address every time it is evaluated? Alias
+  // analysis compares SSA values, so a MustAlias answer about a pointer
+  // computed in a loop only holds within one iteration. Arguments,
+  // globals and values from the entry block (or constant GEPs of them)
+  // cannot change between iterations.
+  static bool isGuaranteedLoopInvariant(const Value *Ptr) {
+    Ptr = Ptr->stripPointerCasts();
+    if (const auto *GEP = dyn_cast<GEPOperator>(Ptr))
+      if (GEP->hasAllConstantIndices())
+        Ptr = GEP->getPointerOperand()->stripPointerCasts();
+    if (const auto *I = dyn_cast<Instruction>(Ptr))
+      return I->getParent()->isEntryBlock();
+    return true;
+  }
+
+  // --- Path-sensitive helper: walk MemorySSA *forward* from Earlier.
+  //
+  // Every access that can observe the memory state Earlier produced is
+  // reachable from it through MemorySSA users, across MemoryPhis on every
+  // outgoing edge. A path ends at a store that writes exactly Earlier's
+  // location, or (when DyingObj is given) at the end of that object's
+  // lifetime; both are collected into Killers. A possible read of the
+  // location on any path before that means the store is live.
+  //
+  // Past a MemoryPhi the path may have gone around a loop, so a killer
+  // found there only counts if the address (or the dying object) cannot
+  // differ between iterations. For the same reason, unless the address is
+  // invariant, a read there is checked against the whole underlying
+  // object: a[i-1] in the next iteration reads what a[i] stored, although
+  // AA compares both within one iteration and finds no alias.
+  //
+  // Returns false if a read was found or the scan limit was hit.
+  static bool findKillersOnAllPaths(MemoryDef *Earlier, AAResults &AA,
+                                    SmallPtrSetImpl<Instruction *> &Killers,
+                                    const Value *DyingObj = nullptr,
+                                    const TargetLibraryInfo *TLI = nullptr) {
+    const auto *EarlierStore = cast<StoreInst>(Earlier->getMemoryInst());
+    MemoryLocation EarlierLoc = MemoryLocation::get(EarlierStore);
+    bool InvariantLoc = isGuaranteedLoopInvariant(EarlierLoc.Ptr);
+    bool InvariantObj = DyingObj && isGuaranteedLoopInvariant(DyingObj);
+    MemoryLocation ObjLoc = MemoryLocation::getBeforeOrAfter(
+        getUnderlyingObject(EarlierLoc.Ptr));
+
+    // Each access with whether the walk reached it through a MemoryPhi
+    SmallVector<std::pair<MemoryAccess *, bool>, 16> Worklist{{Earlier, false}};
+    SmallPtrSet<MemoryAccess *, 16> Visited[2];
+    unsigned Steps = 0;
+
+    while (!Worklist.empty()) {
+      auto [MA, PastPhi] = Worklist.pop_back_val();
+      for (User *U : MA->users()) {
+        auto *UA = cast<MemoryAccess>(U);
+        bool UPastPhi = PastPhi || isa<MemoryPhi>(UA);
+        if (!Visited[UPastPhi].insert(UA).second)
+          continue;
+        if (++Steps > PathScanLimit)
+          return false;
+
+        if (auto *MD = dyn_cast<MemoryDef>(UA)) {
+          if (DyingObj && (!UPastPhi || InvariantObj) &&
+              endsLifetimeOf(MD->getMemoryInst(), DyingObj, *TLI)) {
+            Killers.insert(MD->getMemoryInst());
+            continue;
+          }
+          auto *SI = dyn_cast_or_null<StoreInst>(MD->getMemoryInst());
+          if (SI && isRemovableStore(SI) && (!UPastPhi || InvariantLoc)) {
+            MemoryLocation Loc = MemoryLocation::get(SI);
+            if (AA.alias(Loc, EarlierLoc) == AliasResult::MustAlias &&
+                Loc.Size == EarlierLoc.Size) {
+              Killers.insert(SI);
+              continue;
+            }
+          }
+        }
+        if (mayReadLocation(UA, UPastPhi && !InvariantLoc ? ObjLoc : EarlierLoc,
+                            AA))
+          return false;
+        if (!isa<MemoryUse>(UA))
+          Worklist.push_back({UA, UPastPhi});
+      }
+    }
+    return true;
+  }
+
+  // --- Path-sensitive helper: do the Killers cover every CFG path from
+  //     Earlier to the function exit?
+  //
+  // With a single killer this is the usual post-dominance check. With
+  // several (one per branch of an if/else or switch) no single block
+  // post-dominates Earlier, so walk the CFG forward and make sure every path
+  // meets a killing block before it can leave the function.
+  static bool killersCoverAllPaths(Instruction *Earlier,
+                                   const SmallPtrSetImpl<Instruction *> &Killers,
+                                   PostDominatorTree &PDT) {
+    if (Killers.empty())
+      return false;
+
+    BasicBlock *StartBB = Earlier->getParent();
+    SmallPtrSet<BasicBlock *, 8> KillBlocks;
+    bool KilledInStartBB = false;
+    for (Instruction *K : Killers) {
+      KillBlocks.insert(K->getParent());
+      if (K->getParent() == StartBB && Earlier->comesBefore(K))
+        KilledInStartBB = true;
+    }
+    if (KilledInStartBB)
+      return true;
+
+    if (Killers.size() == 1) {
+      Instruction *K = *Killers.begin();
+      if (K->getParent() != StartBB)
+        return PDT.dominates(K->getParent(), StartBB);
+    }
+
+    SmallVector<BasicBlock *, 16> Worklist(succ_begin(StartBB), succ_end(StartBB));
+    SmallPtrSet<BasicBlock *, 16> Visited;
+    if (Worklist.empty())
+      return false; // Earlier's block leaves the function
+
+    while (!Worklist.empty()) {
+      BasicBlock *BB = Worklist.pop_back_val();
+      if (!Visited.insert(BB).second || KillBlocks.count(BB))
+        continue;
+      if (succ_empty(BB))
+        return false; // reached an exit without being overwritten
+      for (BasicBlock *Succ : successors(BB))
+        Worklist.push_back(Succ);
+    }
+    return true;
+  }
+
+  // Split a store's address into (base pointer, constant byte offset) and
+  // return its size in bytes. Returns nullptr if the store cannot be tracked.
+  static const Value *getStoreExtent(const StoreInst *SI, const DataLayout &DL,
+                                     int64_t &Offset, uint64_t &Size) {
+    if (isa<ScalableVectorType>(SI->getValueOperand()->getType()))
+      return nullptr;
+    MemoryLocation Loc = MemoryLocation::get(SI);
+    if (!Loc.Size.isPrecise())
+      return nullptr;
+    Size = Loc.Size.getValue();
+    Offset = 0;
+    return GetPointerBaseWithConstantOffset(SI->getPointerOperand(), Offset, DL);
+  }
+
+  // memset/memcpy/memmove with a constant length we may delete or trim.
+  static MemIntrinsic *getRemovableMemIntrinsic(Instruction *I) {
+    auto *MI = dyn_cast<MemIntrinsic>(I);
+    if (!MI || MI->isVolatile() || !isa<ConstantInt>(MI->getLength()))
+      return nullptr;
+    return MI;
+  }
+
+  // --- Partial-overwrite phase, part 1: walk one block bottom-up and keep,
+  //     per base pointer, the bytes a later write overwrites before any read.
+  //
+  // A store whose bytes are all in that set is dead, even if it took several
+  // narrower stores to cover it. A constant store that is only partly
+  // covered at its front or back is shrunk to the live bytes. With
+  // -dse-mem-intrinsics, memset/memcpy/memmove take part as well: they cover
+  // bytes for earlier stores, and are deleted or trimmed themselves.
+  //
+  // The two flags are independent. With only -dse-mem-intrinsics, a plain
+  // store is removed only when memory intrinsics alone cover it, so
+  // ByIntrinsics keeps the bytes they wrote apart from Covered.
+  static void removeCoveredStores(BasicBlock &BB, const DataLayout &DL,
+                                  AAResults &AA, OptimizationRemarkEmitter &ORE,
+                                  SmallPtrSetImpl<Instruction *> &Dead,
+                                  unsigned &NumShrunk, unsigned &NumTrimmed) {
+    DenseMap<const Value *, ByteIntervals> Covered, ByIntrinsics;
+
+    // A read of Loc makes the bytes it reads live again.
+    auto MarkRead = [&](const MemoryLocation &Loc) {
+      int64_t ROff = 0;
+      const Value *RBase =
+          GetPointerBaseWithConstantOffset(Loc.Ptr, ROff, DL);
+      for (auto *Map : {&Covered, &ByIntrinsics}) {
+        for (auto It = Map->begin(); It != Map->end();) {
+          auto Cur = It++;
+          if (Cur->first == RBase && Loc.Size.isPrecise()) {
+            Cur->second.remove(ROff, ROff + (int64_t)Loc.Size.getValue());
+            continue;
+          }
+          if (AA.alias(Loc, MemoryLocation::getBeforeOrAfter(Cur->first)) !=
+              AliasResult::NoAlias)
+            Map->erase(Cur);
+        }
+      }
+    };
+
+    for (Instruction &I : llvm::reverse(BB)) {
+      auto *SI = dyn_cast<StoreInst>(&I);
+      if (SI && isRemovableStore(SI)) {
+        int64_t Off;
+        uint64_t Size;
+        const Value *Base = getStoreExtent(SI, DL, Off, Size);
+        if (!Base)
+          continue;
+
+        int64_t End = Off + (int64_t)Size;
+        auto &Killers = DSEPartialOverwrite ? Covered : ByIntrinsics;
+        auto It = Killers.find(Base);
+        if (It != Killers.end()) {
+          int64_t LiveBegin, LiveEnd;
+          if (It->second.covers(Off, End)) {
+            ORE.emit([&]() {
+              return OptimizationRemark(DEBUG_TYPE, "CoveredStore", SI)
+                     << "store is fully covered by later stores";
+            });
+            Dead.insert(SI);
+            continue;
+          }
+          if (DSEPartialOverwrite &&
+              It->second.uncovered(Off, End, LiveBegin, LiveEnd) &&
+              (LiveBegin != Off || LiveEnd != End) &&
+              shrinkStore(SI, DL, LiveBegin - Off, LiveEnd - LiveBegin)) {
+            ORE.emit([&]() {
+              return OptimizationRemark(DEBUG_TYPE, "ShrunkStore", SI)
+                     << "partially overwritten store shrunk to "
+                     << ore::NV("Bytes", LiveEnd - LiveBegin) << " bytes";
+            });
+            ++NumShrunk;
+          }
+        }
+        Covered[Base].add(Off, End);
+        continue;
+      }
+
+      MemIntrinsic *MI = DSEMemIntrinsics ? getRemovableMemIntrinsic(&I) : nullptr;
+      if (MI) {
+        int64_t Off = 0;
+        int64_t Len = cast<ConstantInt>(MI->getLength())->getSExtValue();
+        const Value *Base =
+            GetPointerBaseWithConstantOffset(MI->getRawDest(), Off, DL);
+        int64_t End = Off + Len;
+        auto It = Covered.find(Base);
+        if (Len > 0 && It != Covered.end()) {
+          int64_t LiveBegin, LiveEnd;
+          if (It->second.covers(Off, End)) {
+            ORE.emit([&]() {
+              return OptimizationRemark(DEBUG_TYPE, "CoveredMemIntrinsic", MI)
+                     << "memory intrinsic is fully overwritten later";
+            });
+            Dead.insert(MI);
+            continue;
+          }
+          if (It->second.uncovered(Off, End, LiveBegin, LiveEnd) &&
+              (LiveBegin != Off || LiveEnd != End)) {
+            trimMemIntrinsic(MI, LiveBegin - Off, LiveEnd - LiveBegin);
+            ORE.emit([&]() {
+              return OptimizationRemark(DEBUG_TYPE, "TrimmedMemIntrinsic", MI)
+                     << "partially overwritten memory intrinsic trimmed to "
+                     << ore::NV("Bytes", LiveEnd - LiveBegin) << " bytes";
+            });
+            ++NumTrimmed;
+            Off = LiveBegin;
+            End = LiveEnd;
+          }
+        }
+        // The write happens after the source is read, so record it first;
+        // walking backwards, the read then re-opens the source bytes.
+        if (Len > 0) {
+          Covered[Base].add(Off, End);
+          ByIntrinsics[Base].add(Off, End);
+        }
+        if (auto *MTI = dyn_cast<MemTransferInst>(MI))
+          MarkRead(MemoryLocation::getForSource(MTI));
+        continue;
+      }
+
+      if (!I.mayReadFromMemory() && !I.mayThrow())
+        continue;
+
+      // A call only makes the objects it may read live again.
+      if (isa<CallBase>(I) && !I.mayThrow()) {
+        for (auto *Map : {&Covered, &ByIntrinsics}) {
+          for (auto It = Map->begin(); It != Map->end();) {
+            auto Cur = It++;
+            if (instMayRead(&I, MemoryLocation::getBeforeOrAfter(Cur->first),
+                            AA))
+              Map->erase(Cur);
+          }
+        }
+        continue;
+      }
+
+      // A plain load only makes the bytes it reads live again.
+      auto *LI = dyn_cast<LoadInst>(&I);
+      if (!LI || !LI->isSimple() || I.mayThrow()) {
+        Covered.clear();
+        ByIntrinsics.clear();
+        continue;
+      }
+      MarkRead(MemoryLocation::get(LI));
+    }
+  }
+
+  // Cut a memset/memcpy/memmove down to Size bytes starting Skip bytes into
+  // its original destination (and source).
+  static void trimMemIntrinsic(MemIntrinsic *MI, int64_t Skip, int64_t Size) {
+    IRBuilder<> Builder(MI);
+    if (Skip != 0) {
+      MI->setDest(Builder.CreateConstInBoundsGEP1_64(Builder.getInt8Ty(),
+                                                     MI->getRawDest(), Skip));
+      if (MaybeAlign A = MI->getDestAlign())
+        MI->setDestAlignment(commonAlignment(*A, Skip));
+      if (auto *MTI = dyn_cast<MemTransferInst>(MI)) {
+        MTI->setSource(Builder.CreateConstInBoundsGEP1_64(
+            Builder.getInt8Ty(), MTI->getRawSource(), Skip));
+        if (MaybeAlign A = MTI->getSourceAlign())
+          MTI->setSourceAlignment(commonAlignment(*A, Skip));
+      }
+    }
+    MI->setLength(ConstantInt::get(MI->getLength()->getType(), Size));
+  }
+
+  // Rewrite a constant integer store so it only writes Size bytes starting
+  // Skip bytes into its original location.
+  static bool shrinkStore(StoreInst *SI, const DataLayout &DL, int64_t Skip,
+                          int64_t Size) {
+    auto *C = dyn_cast<ConstantInt>(SI->getValueOperand());
+    if (!C || !isPowerOf2_64(Size) || Size > 8)
+      return false;
+    unsigned TotalBits = C->getBitWidth();
+    if (TotalBits % 8 != 0)
+      return false;
+
+    unsigned ShiftBits = DL.isBigEndian()
+                             ? TotalBits - (unsigned)(Skip + Size) * 8
+                             : (unsigned)Skip * 8;
+    APInt Bits = C->getValue().lshr(ShiftBits).trunc((unsigned)Size * 8);
+
+    IRBuilder<> Builder(SI);
+    Value *Ptr = SI->getPointerOperand();
+    if (Skip != 0)
+      Ptr = Builder.CreateConstInBoundsGEP1_64(Builder.getInt8Ty(), Ptr, Skip);
+    SI->setOperand(0, ConstantInt::get(SI->getContext(), Bits));
+    SI->setOperand(1, Ptr);
+    SI->setAlignment(commonAlignment(SI->getAlign(), Skip));
+    return true;
+  }
+
+  // --- Partial-overwrite phase, part 2: merge runs of adjacent narrow
+  //     constant stores to one base pointer into a single 2/4/8-byte store.
+  //
+  // Only stores with nothing that touches memory between them are merged, so
+  // the wide store can take the place of the last one in the run.
+  static unsigned mergeAdjacentStores(BasicBlock &BB, const DataLayout &DL,
+                                      MemorySSA &MSSA,
+                                      MemorySSAUpdater &Updater,
+                                      OptimizationRemarkEmitter &ORE) {
+    struct Slot {
+      StoreInst *SI;
+      int64_t Off;
+      uint64_t Size;
+    };
+    SmallVector<SmallVector<Slot, 8>, 4> Runs;
+    SmallVector<Slot, 8> Run;
+    const Value *RunBase = nullptr;
+
+    auto Flush = [&]() {
+      if (Run.size() > 1)
+        Runs.push_back(Run);
+      Run.clear();
+      RunBase = nullptr;
+    };
+
+    for (Instruction &I : BB) {
+      auto *SI = dyn_cast<StoreInst>(&I);
+      if (SI && isRemovableStore(SI) && isa<ConstantInt>(SI->getValueOperand())) {
+        int64_t Off;
+        uint64_t Size;
+        const Value *Base = getStoreExtent(SI, DL, Off, Size);
+        unsigned Bits = SI->getValueOperand()->getType()->getIntegerBitWidth();
+        if (Base && Bits == Size * 8 && Size < 8) {
+          if (Base != RunBase)
+            Flush();
+          RunBase = Base;
+          Run.push_back({SI, Off, Size});
+          continue;
+        }
+      }
+      if (I.mayReadOrWriteMemory() || I.mayThrow())
+        Flush();
+    }
+    Flush();
+
+    unsigned NumMerged = 0;
+    for (auto &R : Runs) {
+      SmallVector<Slot, 8> Sorted(R.begin(), R.end());
+      llvm::sort(Sorted, [](const Slot &A, const Slot &B) { return A.Off < B.Off; });
+
+      // Overlapping stores depend on program order; leave them alone.
+      bool Overlap = false;
+      for (unsigned i = 1; i < Sorted.size(); ++i)
+        if (Sorted[i].Off < Sorted[i - 1].Off + (int64_t)Sorted[i - 1].Size)
+          Overlap = true;
+      if (Overlap)
+        continue;
+
+      for (unsigned i = 0; i < Sorted.size();) {
+        // Longest contiguous window starting at i whose size is 2, 4 or 8.
+        unsigned Best = i;
+        uint64_t Total = Sorted[i].Size, BestTotal = 0;
+        for (unsigned j = i + 1; j < Sorted.size(); ++j) {
+          if (Sorted[j].Off != Sorted[j - 1].Off + (int64_t)Sorted[j - 1].Size)
+            break;
+          Total += Sorted[j].Size;
+          if (Total > 8)
+            break;
+          if (isPowerOf2_64(Total)) {
+            Best = j;
+            BestTotal = Total;
+          }
+        }
+        if (Best == i) {
+          ++i;
+          continue;
+        }
+
+        APInt Wide(BestTotal * 8, 0);
+        StoreInst *Last = Sorted[i].SI;
+        for (unsigned k = i; k <= Best; ++k) {
+          const Slot &S = Sorted[k];
+          uint64_t Rel = S.Off - Sorted[i].Off;
+          unsigned Shift = DL.isBigEndian() ? (BestTotal - Rel - S.Size) * 8
+                                            : Rel * 8;
+          APInt Part = cast<ConstantInt>(S.SI->getValueOperand())->getValue();
+          Wide |= Part.zext(BestTotal * 8).shl(Shift);
+          if (Last->comesBefore(S.SI))
+            Last = S.SI;
+        }
+
+        ORE.emit([&]() {
+          return OptimizationRemark(DEBUG_TYPE, "MergedStores", Last)
+                 << "merged " << ore::NV("Stores", Best - i + 1)
+                 << " adjacent stores into one "
+                 << ore::NV("Bytes", BestTotal) << "-byte store";
+        });
+
+        // Reuse the last store of the window as the wide store.
+        StoreInst *Lowest = Sorted[i].SI;
+        Value *Ptr = Lowest->getPointerOperand();
+        Align A = Lowest->getAlign();
+        Last->setOperand(0, ConstantInt::get(BB.getContext(), Wide));
+        Last->setOperand(1, Ptr);
+        Last->setAlignment(A);
+
+        MemoryAccess *LastMA = MSSA.getMemoryAccess(Last);
+        for (unsigned k = i; k <= Best; ++k) {
+          StoreInst *Old = Sorted[k].SI;
+          if (Old == Last)
+            continue;
+          if (MemoryAccess *MA = MSSA.getMemoryAccess(Old)) {
+            // Reads below the window that were optimized to this store now
+            // see the wide store instead. Writes optimized to it forget
+            // their cached clobber, so the walker recomputes it.
+            for (User *U : make_early_inc_range(MA->users())) {
+              if (auto *MU = dyn_cast<MemoryUse>(U))
+                MU->setOptimized(LastMA);
+              else if (auto *MD = dyn_cast<MemoryDef>(U))
+                if (MD->isOptimized() && MD->getOptimized() == MA)
+                  MD->resetOptimized();
+            }
+            Updater.removeMemoryAccess(MA);
+          }
+          Old->eraseFromParent();
+        }
+        ++NumMerged;
+        i = Best + 1;
+      }
+    }
+    return NumMerged;
+  }
+
+  // --- Loop phase: a store that runs on every iteration of L, to a location
+  //     nothing else in L reads or writes, is only observable after the
+  //     loop. Its last value is stored once in the exit block instead.
+  //
+  // Requires one exiting block that the store dominates (so the last
+  // iteration always stores) and a single exit block reached only from it.
+  // For-loops have to be rotated first (loop-rotate); otherwise the header is
+  // the exiting block and the body may not run at all.
+  //
+  // If anything in the loop may throw, the unwinder can leave mid-loop and
+  // whoever catches the exception sees the value of the last iteration that
+  // ran. Then only an object nobody can see after unwinding qualifies: a
+  // local alloca or a heap allocation that does not escape.
+  static StoreInst *sinkLoopStore(Loop *L, StoreInst *SI, DominatorTree &DT,
+                                  MemorySSA &MSSA, MemorySSAUpdater &Updater,
+                                  AAResults &AA, const TargetLibraryInfo &TLI) {
+    BasicBlock *Exiting = L->getExitingBlock();
+    BasicBlock *Exit = L->getUniqueExitBlock();
+    if (!Exiting || !Exit || Exit->getSinglePredecessor() != Exiting ||
+        Exit->isEHPad() || !DT.dominates(SI->getParent(), Exiting))
+      return nullptr;
+
+    Value *Ptr = SI->getPointerOperand();
+    if (!L->isLoopInvariant(Ptr))
+      return nullptr;
+
+    const Value *Obj = getUnderlyingObject(Ptr);
+    if (!isa<AllocaInst>(Obj) && !isInvisibleAfterReturn(Obj, TLI))
+      for (BasicBlock *BB : L->blocks())
+        for (Instruction &I : *BB)
+          if (I.mayThrow())
+            return nullptr;
+
+    // The store must be the only access in the loop that touches the location.
+    MemoryLocation Loc = MemoryLocation::get(SI);
+    for (BasicBlock *BB : L->blocks()) {
+      const auto *Accesses = MSSA.getBlockAccesses(BB);
+      if (!Accesses)
+        continue;
+      for (const MemoryAccess &MA : *Accesses) {
+        const auto *MUD = dyn_cast<MemoryUseOrDef>(&MA);
+        if (!MUD || MUD->getMemoryInst() == SI)
+          continue;
+        if (isModOrRefSet(AA.getModRefInfo(MUD->getMemoryInst(), Loc)))
+          return nullptr;
+      }
+    }
+
+    // The stored value from the last iteration, through an LCSSA phi if it
+    // is computed inside the loop.
+    IRBuilder<> B(Exit, Exit->getFirstInsertionPt());
+    Value *Val = SI->getValueOperand();
+    auto *ValI = dyn_cast<Instruction>(Val);
+    if (ValI && L->contains(ValI)) {
+      PHINode *PN = B.CreatePHI(Val->getType(), 1, Val->getName() + ".lcssa");
+      PN->addIncoming(Val, Exiting);
+      Val = PN;
+    }
+    StoreInst *NewSI = B.CreateAlignedStore(Val, Ptr, SI->getAlign());
+    NewSI->setAAMetadata(SI->getAAMetadata());
+    NewSI->setDebugLoc(SI->getDebugLoc());
+
+    MemoryAccess *NewMA = nullptr;
+    for (auto It = std::next(NewSI->getIterator()); It != Exit->end(); ++It)
+      if (auto *Next = MSSA.getMemoryAccess(&*It)) {
+        NewMA = Updater.createMemoryAccessBefore(NewSI, nullptr, Next);
+        break;
+      }
+    if (!NewMA)
+      NewMA = Updater.createMemoryAccessInBB(NewSI, nullptr, Exit,
+                                             MemorySSA::End);
+    Updater.insertDef(cast<MemoryDef>(NewMA), /*RenameUses=*/true);
+
+    Updater.removeMemoryAccess(MSSA.getMemoryAccess(SI));
+    SI->eraseFromParent();
+    return NewSI;
+  }
+
+  static unsigned sinkLoopStores(LoopInfo &LI, DominatorTree &DT,
+                                 MemorySSA &MSSA, MemorySSAUpdater &Updater,
+                                 AAResults &AA, const TargetLibraryInfo &TLI,
+                                 OptimizationRemarkEmitter &ORE) {
+    unsigned NumSunk = 0;
+    // Innermost loops first, so a store sunk out of an inner loop can be
+    // sunk again out of the loop around it.
+    for (Loop *L : llvm::reverse(LI.getLoopsInPreorder())) {
+      SmallVector<StoreInst *, 8> Stores;
+      for (BasicBlock *BB : L->blocks())
+        if (LI.getLoopFor(BB) == L)
+          for (Instruction &I : *BB)
+            if (isRemovableStore(&I))
+              Stores.push_back(cast<StoreInst>(&I));
+
+      for (StoreInst *SI : Stores) {
+        if (StoreInst *NewSI =
+                sinkLoopStore(L, SI, DT, MSSA, Updater, AA, TLI)) {
+          // NewSI carries the old store's debug location.
+          ORE.emit([&]() {
+            return OptimizationRemark(DEBUG_TYPE, "SunkLoopStore", NewSI)
+                   << "store overwritten on every iteration sunk to the "
+                      "loop exit";
+          });
+          ++NumSunk;
+        }
+      }
+    }
+    return NumSunk;
+  }
+
+  // --- Helper: is D a "store (load p), p" that changes nothing?
+  //
+  // The value stored must come from a simple load of exactly the same
+  // location, and the MemorySSA walker must report the same clobbering
+  // access for the load and for the store. Any write to the location between
+  // the two would be the store's clobber instead, and differ from the load's.
+  static bool isNoopStore(MemoryDef *D, MemorySSA &MSSA, AAResults &AA) {
+    auto *SI = dyn_cast<StoreInst>(D->getMemoryInst());
+    if (!SI || !isRemovableStore(SI))
+      return false;
+    auto *LI = dyn_cast<LoadInst>(SI->getValueOperand());
+    if (!LI || !LI->isSimple())
+      return false;
+
+    MemoryLocation StoreLoc = MemoryLocation::get(SI);
+    MemoryLocation LoadLoc = MemoryLocation::get(LI);
+    if (AA.alias(StoreLoc, LoadLoc) != AliasResult::MustAlias ||
+        StoreLoc.Size != LoadLoc.Size)
+      return false;
+
+    auto *LoadMA = MSSA.getMemoryAccess(LI);
+    if (!LoadMA)
+      return false;
+    auto *Walker = MSSA.getWalker();
+    return Walker->getClobberingMemoryAccess(LoadMA) ==
+           Walker->getClobberingMemoryAccess(D);
+  }
+
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
     auto &AA   = AM.getResult<AAManager>(F);
     auto &MSSAR = AM.getResult<MemorySSAAnalysis>(F);
     MemorySSA &MSSA = MSSAR.getMSSA();
     auto &PDT  = AM.getResult<PostDominatorTreeAnalysis>(F);
 
-    MemorySSAUpdater Updater(&MSSA);
+    auto &ORE  = AM.getResult<OptimizationRemarkEmitterAnalysis>(F);
 
-    errs() << "Running Dead Store Elimination on function: " << F.getName() << "\n";
-    errs() << "========================================\n";
+    MemorySSAUpdater Updater(&MSSA);
 
     // Collect all MemoryDefs for a reverse walk.
     SmallVector<MemoryDef*, 32> MemDefs;
@@ -114,88 +1220,171 @@ struct DeadStoreEliminationPass : PassInfoMixin<DeadStoreEliminationPass> {
     // stores "kill" the same earlier store.
     SmallPtrSet<Instruction*, 16> Dead;
 
-    // Walk MemoryDefs in reverse "program order".
-    for (auto *D : llvm::reverse(MemDefs)) {
-      Instruction *Inst = D->getMemoryInst();
+    // Single-killer rule: a store is dead if the next write to its location
+    // overwrites it exactly. Both engines find the same stores.
+    if (DSEBackwardSweep) {
+      sweepBackward(F, MSSA, AA, PDT, ORE, Dead);
+    } else {
+      // Walk MemoryDefs in reverse "program order".
+      for (auto *D : llvm::reverse(MemDefs)) {
+        Instruction *Inst = D->getMemoryInst();
 
-      // We only care about *stores* as potential killers.
-      if (!isRemovableStore(Inst))
-        continue;
-      auto *SI = cast<StoreInst>(Inst);
+        // We only care about *stores* as potential killers.
+        if (!isKillCandidate(Inst))
+          continue;
+        auto *SI = cast<StoreInst>(Inst);
 
-      errs() << "Examining store: ";
-      Inst->print(errs());
-      errs() << "\n";
+        // Use the MemorySSA walker to find what this store clobbers (previous write).
+        auto *Walker = MSSA.getWalker();
+        MemoryAccess *Prev = Walker->getClobberingMemoryAccess(D);
 
-      // Use the MemorySSA walker to find what this store clobbers (previous write).
-      auto *Walker = MSSA.getWalker();
-      MemoryAccess *Prev = Walker->getClobberingMemoryAccess(D);
+        // Only proceed if the clobber is another MemoryDef (i.e. a previous write).
+        auto *PrevDef = dyn_cast<MemoryDef>(Prev);
+        if (!PrevDef || MSSA.isLiveOnEntryDef(PrevDef)) {
+          reportRejected(ORE, NumRejectNoPriorWrite, "NoPriorWrite", SI,
+                         "no prior write to the location");
+          continue;
+        }
 
-      errs() << "  Clobbering access: ";
-      Prev->print(errs());
-      errs() << "\n";
+        Instruction *PrevInst = PrevDef->getMemoryInst();
+        auto *PrevSI = dyn_cast<StoreInst>(PrevInst);
+        if (!PrevSI) {
+          reportRejected(ORE, NumRejectNotStore, "ClobberNotStore", SI,
+                         "previous write is not a store");
+          continue;
+        }
 
-      // Only proceed if the clobber is another MemoryDef (i.e. a previous write).
-      auto *PrevDef = dyn_cast<MemoryDef>(Prev);
-      if (!PrevDef) {
-        errs() << "  -> Not a MemoryDef (no prior write), skipping\n";
-        continue;
-      }
+        // Skip non-removable stores (volatile/ordered atomic).
+        if (!isKillCandidate(PrevSI)) {
+          reportRejected(ORE, NumRejectVolatile, "ClobberVolatile", SI,
+                         "previous store is volatile/atomic");
+          continue;
+        }
 
-      Instruction *PrevInst = PrevDef->getMemoryInst();
-      auto *PrevSI = dyn_cast<StoreInst>(PrevInst);
-      if (!PrevSI) {
-        errs() << "  -> Previous instruction is not a store, skipping\n";
-        continue;
-      }
+        // Require exact same location: MustAlias + same size.
+        MemoryLocation LocNew = MemoryLocation::get(SI);
+        MemoryLocation LocOld = MemoryLocation::get(PrevSI);
+        AliasResult AR = AA.alias(LocNew, LocOld);
+        if (AR != AliasResult::MustAlias || LocNew.Size != LocOld.Size) {
+          reportRejected(ORE, NumRejectNotMustAlias, "NotMustAlias", SI,
+                         "not MustAlias and same-size");
+          continue;
+        }
 
-      // Skip non-removable stores (volatile/atomic).
-      if (!isRemovableStore(PrevSI)) {
-        errs() << "  -> Previous store is volatile/atomic, skipping\n";
-        continue;
-      }
+        if (!atomicOrderingAllowsKill(PrevSI, SI)) {
+          reportRejected(ORE, NumRejectAtomic, "AtomicOrdering", SI,
+                         "atomic ordering does not allow the kill");
+          continue;
+        }
 
-      errs() << "  Previous store: ";
-      PrevInst->print(errs());
-      errs() << "\n";
+        // Intervening use on any path (via MSSA chain)? If yes, we cannot remove.
+        if (hasInterveningUseMSSA(PrevDef, D, AA)) {
+          reportRejected(ORE, NumRejectInterveningUse, "InterveningUse", SI,
+                         "intervening use (MSSA chain)");
+          continue;
+        }
 
-      // Require exact same location: MustAlias + same size.
-      MemoryLocation LocNew = MemoryLocation::get(SI);
-      MemoryLocation LocOld = MemoryLocation::get(PrevSI);
-      AliasResult AR = AA.alias(LocNew, LocOld);
-      if (AR != AliasResult::MustAlias || LocNew.Size != LocOld.Size) {
-        errs() << "  -> Not MustAlias and same-size; skipping (AR=" << (int)AR << ")\n";
-        continue;
-      }
+        // Post-dominance: the later store must post-dominate the earlier write's BB,
+        // ensuring the earlier store is always overwritten on all paths.
+        if (!PDT.dominates(SI->getParent(), PrevInst->getParent())) {
+          reportRejected(ORE, NumRejectNotPostDom, "NotPostDominated", SI,
+                         "does not post-dominate the earlier store");
+          continue;
+        }
 
-      // Intervening use on any path (via MSSA chain)? If yes, we cannot remove.
-      if (hasInterveningUseMSSA(PrevDef, D, AA)) {
-        errs() << "  -> Has intervening use (MSSA chain), skipping\n";
-        continue;
+        // Mark earlier store dead.
+        ORE.emit([&]() {
+          return OptimizationRemark(DEBUG_TYPE, "DeadStore", PrevInst)
+                 << "store is overwritten by " << ore::NV("Killer", SI)
+                 << " before any read";
+        });
+        Dead.insert(PrevInst);
       }
+    }
 
-      // Post-dominance: the later store must post-dominate the earlier write's BB,
-      // ensuring the earlier store is always overwritten on all paths.
-      if (!PDT.dominates(SI->getParent(), PrevInst->getParent())) {
-        errs() << "  -> Later store does not post-dominate earlier store, skipping\n";
-        continue;
+    // Path-sensitive sweep: stores the single-killer walk above could not
+    // prove dead because the overwrites sit behind a MemoryPhi.
+    if (DSEPathSensitive) {
+      for (auto *D : MemDefs) {
+        Instruction *Inst = D->getMemoryInst();
+        if (!isRemovableStore(Inst) || Dead.count(Inst))
+          continue;
+
+        SmallPtrSet<Instruction *, 4> Killers;
+        if (!findKillersOnAllPaths(D, AA, Killers) ||
+            !killersCoverAllPaths(Inst, Killers, PDT))
+          continue;
+
+        ORE.emit([&]() {
+          return OptimizationRemark(DEBUG_TYPE, "DeadStoreAllPaths", Inst)
+                 << "store is overwritten on all paths by "
+                 << ore::NV("Killers", (unsigned)Killers.size())
+                 << " later store(s)";
+        });
+        Dead.insert(Inst);
       }
+    }
+
+    // End-of-lifetime sweep: a store into an object that is invisible after
+    // return is dead if no path reads it before return, lifetime.end or free.
+    // No coverage check is needed; leaving the function ends the object too.
+    // Any other object is only dead once freed, so there every path has to
+    // reach a free/delete (or an overwrite) before it leaves the function.
+    if (DSEEndOfLifetime) {
+      auto &TLI = AM.getResult<TargetLibraryAnalysis>(F);
+      SmallPtrSet<const Value *, 8> Freed;
+      for (auto *D : MemDefs)
+        if (const Value *P = getFreedPointer(D->getMemoryInst(), TLI))
+          Freed.insert(getUnderlyingObject(P));
+
+      SmallDenseMap<const Value *, bool, 8> Invisible;
+      for (auto *D : MemDefs) {
+        Instruction *Inst = D->getMemoryInst();
+        if (!isRemovableStore(Inst) || Dead.count(Inst))
+          continue;
 
-      // Mark earlier store dead.
-      errs() << "  -> Earlier store is DEAD and will be removed: ";
-      PrevInst->print(errs());
-      errs() << "\n";
+        const Value *Obj =
+            getUnderlyingObject(cast<StoreInst>(Inst)->getPointerOperand());
+        auto It = Invisible.find(Obj);
+        if (It == Invisible.end())
+          It = Invisible.insert({Obj, isInvisibleAfterReturn(Obj, TLI)}).first;
+        if (!It->second && !Freed.count(Obj))
+          continue;
 
-      Dead.insert(PrevInst);
+        SmallPtrSet<Instruction *, 4> Killers;
+        if (!findKillersOnAllPaths(D, AA, Killers, Obj, &TLI))
+          continue;
+        if (!It->second && !killersCoverAllPaths(Inst, Killers, PDT))
+          continue;
+
+        ORE.emit([&]() {
+          if (It->second)
+            return OptimizationRemark(DEBUG_TYPE, "DeadStoreEndOfLifetime", Inst)
+                   << "store to a non-escaping object is never read";
+          return OptimizationRemark(DEBUG_TYPE, "DeadStoreFreed", Inst)
+                 << "store to a freed object is never read";
+        });
+        Dead.insert(Inst);
+      }
     }
 
+    // No-op stores are found before any deletion, while MemDefs is still
+    // valid; stores already marked dead are counted as dead.
+    SmallVector<Instruction *, 8> Noops;
+    if (DSENoopStores)
+      for (auto *D : MemDefs)
+        if (!Dead.count(D->getMemoryInst()) && isNoopStore(D, MSSA, AA)) {
+          ORE.emit([&]() {
+            return OptimizationRemark(DEBUG_TYPE, "NoopStore",
+                                      D->getMemoryInst())
+                   << "store writes back the value just loaded";
+          });
+          Noops.push_back(D->getMemoryInst());
+        }
+
     // Apply deletions and update MemorySSA accordingly.
     unsigned NumDead = 0;
     for (Instruction *DeadStore : Dead) {
-      errs() << "Removing dead store: ";
-      DeadStore->print(errs());
-      errs() << "\n";
-
       if (auto *MA = MSSA.getMemoryAccess(DeadStore))
         Updater.removeMemoryAccess(MA);
 
@@ -203,16 +1392,421 @@ struct DeadStoreEliminationPass : PassInfoMixin<DeadStoreEliminationPass> {
       ++NumDead;
     }
 
-    errs() << "\n========================================\n";
-    errs() << "Dead Store Elimination completed!\n";
-    errs() << "Total dead stores eliminated: " << NumDead << "\n";
-    errs() << "========================================\n\n";
+    // No-op store phase: "store (load p), p" with no clobber in between.
+    unsigned NumNoop = 0;
+    for (Instruction *NoopStore : Noops) {
+      Updater.removeMemoryAccess(MSSA.getMemoryAccess(NoopStore));
+      NoopStore->eraseFromParent();
+      ++NumNoop;
+    }
+
+    // Partial-overwrite phase: byte-range DSE, shrinking and store merging
+    // inside each block, on top of what the exact-overwrite rules removed.
+    // Memory intrinsics only need the byte-range part.
+    unsigned NumShrunk = 0, NumMerged = 0, NumTrimmed = 0;
+    if (DSEPartialOverwrite || DSEMemIntrinsics) {
+      const DataLayout &DL = F.getParent()->getDataLayout();
+      for (auto &BB : F) {
+        SmallPtrSet<Instruction *, 16> Covered;
+        removeCoveredStores(BB, DL, AA, ORE, Covered, NumShrunk,
+                            NumTrimmed);
+        for (Instruction *DeadStore : Covered) {
+          if (auto *MA = MSSA.getMemoryAccess(DeadStore))
+            Updater.removeMemoryAccess(MA);
+          DeadStore->eraseFromParent();
+          ++NumDead;
+        }
+        if (DSEPartialOverwrite)
+          NumMerged += mergeAdjacentStores(BB, DL, MSSA, Updater, ORE);
+      }
+    }
+
+    // Loop phase: sink stores that are overwritten on every iteration.
+    unsigned NumSunk = 0;
+    if (DSELoopSink) {
+      auto &LI = AM.getResult<LoopAnalysis>(F);
+      auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+      auto &TLI = AM.getResult<TargetLibraryAnalysis>(F);
+      NumSunk = sinkLoopStores(LI, DT, MSSA, Updater, AA, TLI, ORE);
+    }
+
+    NumDeadStores += NumDead;
+    NumNoopStores += NumNoop;
+    NumShrunkStores += NumShrunk;
+    NumMergedRuns += NumMerged;
+    NumTrimmedIntrinsics += NumTrimmed;
+    NumSunkStores += NumSunk;
+
+    ORE.emit([&]() {
+      return OptimizationRemarkAnalysis(DEBUG_TYPE, "Summary",
+                                        DiagnosticLocation(F.getSubprogram()),
+                                        &F.getEntryBlock())
+             << "removed " << ore::NV("DeadStores", NumDead)
+             << " dead and " << ore::NV("NoopStores", NumNoop)
+             << " no-op stores, shrunk " << ore::NV("Shrunk", NumShrunk)
+             << ", merged " << ore::NV("Merged", NumMerged)
+             << " runs, trimmed " << ore::NV("Trimmed", NumTrimmed)
+             << " intrinsics, sunk " << ore::NV("Sunk", NumSunk)
+             << " loop stores";
+    });
+
+    if (NumDead == 0 && NumNoop == 0 && NumShrunk == 0 && NumMerged == 0 &&
+        NumTrimmed == 0 && NumSunk == 0)
+      return PreservedAnalyses::all();
+
+    // Every phase only deletes or rewrites memory instructions (the loop
+    // phase adds a store and an LCSSA phi) and keeps MemorySSA up to date
+    // through the updater; no block or edge changes.
+    if (VerifyMemorySSA)
+      MSSA.verifyMemorySSA();
+
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    PA.preserve<MemorySSAAnalysis>();
+    return PA;
+  }
+};
+
+
+// ---------------------------------------------------------------------------
+// Redundant load elimination: the mirror image of DSE on the same MemorySSA
+// def chains. A load is replaced by the value of the store it is clobbered
+// by, if that store writes the same address, or by an earlier load of the
+// same pointer that nothing may have written since.
+// ---------------------------------------------------------------------------
+
+#undef DEBUG_TYPE
+#define DEBUG_TYPE "rle-mssa"
+
+STATISTIC(NumForwardedLoads, "The # of loads replaced by a stored value");
+STATISTIC(NumReusedLoads, "The # of loads replaced by an earlier load");
+
+struct RedundantLoadEliminationPass
+    : PassInfoMixin<RedundantLoadEliminationPass> {
+
+  // A load seen so far and the value it is known to produce: the load
+  // itself, or what it was replaced by.
+  struct AvailableLoad {
+    LoadInst *Load;
+    Value *Val;
+  };
+
+  // Do both pointers point to the same first byte?
+  static bool isSameAddress(const Value *A, const Value *B,
+                            const DataLayout &DL, AAResults &AA) {
+    int64_t OffA = 0, OffB = 0;
+    const Value *BaseA = GetPointerBaseWithConstantOffset(A, OffA, DL);
+    const Value *BaseB = GetPointerBaseWithConstantOffset(B, OffB, DL);
+    if (BaseA == BaseB)
+      return OffA == OffB;
+    return AA.isMustAlias(A, B);
+  }
+
+  // Turn V, read from the start of the same address, into a value of type
+  // LoadTy: a no-op or bit cast if both are the same size, otherwise the
+  // first LoadTy-sized bytes of V (a shift and truncation through an
+  // integer). Returns nullptr if the load reads more than V has or the
+  // types cannot be converted bit for bit.
+  static Value *coerceToLoadType(Value *V, Type *LoadTy, LoadInst *InsertPt,
+                                 const DataLayout &DL) {
+    Type *ValTy = V->getType();
+    if (ValTy == LoadTy)
+      return V;
+
+    auto IsPlainScalar = [&](Type *T) {
+      if (T->isPtrOrPtrVectorTy())
+        return !T->isVectorTy() && !DL.isNonIntegralPointerType(T);
+      return T->isIntOrIntVectorTy() || T->isFPOrFPVectorTy();
+    };
+    if (!IsPlainScalar(ValTy) || !IsPlainScalar(LoadTy))
+      return nullptr;
+
+    TypeSize ValBits = DL.getTypeSizeInBits(ValTy);
+    TypeSize LoadBits = DL.getTypeSizeInBits(LoadTy);
+    if (ValBits.isScalable() || LoadBits.isScalable())
+      return nullptr;
+    // Types with padding bits (i1, x86_fp80) do not map byte for byte.
+    if (DL.getTypeStoreSizeInBits(ValTy) != ValBits ||
+        DL.getTypeStoreSizeInBits(LoadTy) != LoadBits)
+      return nullptr;
+    if (LoadBits.getFixedValue() > ValBits.getFixedValue())
+      return nullptr;
+
+    IRBuilder<> Builder(InsertPt);
+    if (LoadBits == ValBits &&
+        CastInst::isBitOrNoopPointerCastable(ValTy, LoadTy, DL))
+      return Builder.CreateBitOrPointerCast(V, LoadTy);
+    if (ValTy->isPointerTy() && LoadTy->isPointerTy())
+      return nullptr; // different address spaces
+
+    LLVMContext &Ctx = V->getContext();
+    Type *ValIntTy = IntegerType::get(Ctx, ValBits.getFixedValue());
+    Type *LoadIntTy = IntegerType::get(Ctx, LoadBits.getFixedValue());
+    Value *Bits = ValTy->isPointerTy() ? Builder.CreatePtrToInt(V, ValIntTy)
+                                       : Builder.CreateBitCast(V, ValIntTy);
+    // The load reads the first bytes in memory, which are the high bits on
+    // a big-endian target.
+    if (DL.isBigEndian() && ValBits != LoadBits)
+      Bits = Builder.CreateLShr(Bits, ValBits.getFixedValue() -
+                                          LoadBits.getFixedValue());
+    Bits = Builder.CreateTrunc(Bits, LoadIntTy);
+    return LoadTy->isPointerTy() ? Builder.CreateIntToPtr(Bits, LoadTy)
+                                 : Builder.CreateBitCast(Bits, LoadTy);
+  }
+
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+    auto &MSSA = AM.getResult<MemorySSAAnalysis>(F).getMSSA();
+    auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+    auto &AA = AM.getResult<AAManager>(F);
+    auto &ORE = AM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+    const DataLayout &DL = F.getParent()->getDataLayout();
+    MemorySSAWalker *Walker = MSSA.getWalker();
+    MemorySSAUpdater Updater(&MSSA);
+
+    // Replaced loads stay in the IR until the end, so MemorySSA and the
+    // dominator tree can still be asked about them as earlier loads.
+    SmallVector<LoadInst *, 16> Replaced;
+    DenseMap<const Value *, SmallVector<AvailableLoad, 2>> LoadsOf;
+    unsigned NumForwarded = 0, NumReused = 0;
+
+    // Dominator-tree preorder: every load that dominates LI is seen first.
+    for (DomTreeNode *Node : depth_first(DT.getRootNode())) {
+      for (Instruction &I : *Node->getBlock()) {
+        auto *LI = dyn_cast<LoadInst>(&I);
+        if (!LI || !LI->isSimple())
+          continue;
+        auto *MA = MSSA.getMemoryAccess(LI);
+        if (!MA)
+          continue;
+
+        const Value *Ptr = LI->getPointerOperand()->stripPointerCasts();
+        MemoryAccess *Clobber = Walker->getClobberingMemoryAccess(LI);
+        Value *NewVal = nullptr;
+
+        // Store-to-load forwarding: the clobber is a store to this address.
+        auto *Def = dyn_cast<MemoryDef>(Clobber);
+        auto *SI = Def ? dyn_cast_or_null<StoreInst>(Def->getMemoryInst())
+                       : nullptr;
+        if (SI && SI->isSimple() &&
+            isSameAddress(SI->getPointerOperand(), LI->getPointerOperand(),
+                          DL, AA)) {
+          NewVal = coerceToLoadType(SI->getValueOperand(), LI->getType(), LI,
+                                    DL);
+          if (NewVal) {
+            ++NumForwarded;
+            ORE.emit([&]() {
+              return OptimizationRemark(DEBUG_TYPE, "LoadForwarded", LI)
+                     << "load replaced by the value stored by "
+                     << ore::NV("Store", SI);
+            });
+          }
+        }
+
+        // Load reuse: an earlier load of the same pointer that dominates
+        // LI, with LI's clobber above it, so nothing can write the location
+        // between the two.
+        if (!NewVal) {
+          for (AvailableLoad &Earlier : LoadsOf.lookup(Ptr)) {
+            if (!DT.dominates(Earlier.Load, LI) ||
+                !MSSA.dominates(Clobber, MSSA.getMemoryAccess(Earlier.Load)))
+              continue;
+            NewVal = coerceToLoadType(Earlier.Val, LI->getType(), LI, DL);
+            if (!NewVal)
+              continue;
+            ++NumReused;
+            ORE.emit([&]() {
+              return OptimizationRemark(DEBUG_TYPE, "LoadReused", LI)
+                     << "load replaced by the earlier load "
+                     << ore::NV("Load", Earlier.Load);
+            });
+            break;
+          }
+        }
+
+        if (NewVal) {
+          LI->replaceAllUsesWith(NewVal);
+          Replaced.push_back(LI);
+        }
+        LoadsOf[Ptr].push_back({LI, NewVal ? NewVal : LI});
+      }
+    }
+
+    for (LoadInst *LI : Replaced) {
+      Updater.removeMemoryAccess(LI);
+      LI->eraseFromParent();
+    }
 
-    // If we modified anything, be conservative about preserved analyses.
-    if (NumDead > 0)
-      return PreservedAnalyses::none();
+    NumForwardedLoads += NumForwarded;
+    NumReusedLoads += NumReused;
 
-    return PreservedAnalyses::all();
+    if (Replaced.empty())
+      return PreservedAnalyses::all();
+
+    // Only loads were removed (and casts added), so no MemoryDef and no
+    // edge changed.
+    if (VerifyMemorySSA)
+      MSSA.verifyMemorySSA();
+
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    PA.preserve<MemorySSAAnalysis>();
+    return PA;
+  }
+};
+
+
+// ---------------------------------------------------------------------------
+// Dead global store elimination: a module pass that removes internal and
+// private globals nothing ever reads, together with every store to them.
+// ---------------------------------------------------------------------------
+
+#undef DEBUG_TYPE
+#define DEBUG_TYPE "dse-globals"
+
+STATISTIC(NumDeadGlobals, "The # of write-only globals removed");
+STATISTIC(NumDeadGlobalStores, "The # of stores to write-only globals removed");
+
+struct DeadGlobalStoreEliminationPass
+    : PassInfoMixin<DeadGlobalStoreEliminationPass> {
+
+  // Collects the stores, memory intrinsics and unused atomicrmws that write
+  // through V, an address derived from the global, and the loads from it.
+  // Returns false if any use may let the address escape or observe the
+  // global some other way: calls, memcpy sources, volatile accesses,
+  // storing the address itself, comparisons, ptrtoint or any constant other
+  // than a GEP or cast expression.
+  static bool collectAccesses(Value *V, SmallVectorImpl<Instruction *> &Writes,
+                              SmallVectorImpl<LoadInst *> &Reads,
+                              SmallPtrSetImpl<Value *> &Visited) {
+    if (!Visited.insert(V).second)
+      return true;
+    for (User *U : V->users()) {
+      if (auto *SI = dyn_cast<StoreInst>(U)) {
+        if (SI->getValueOperand() == V || SI->isVolatile())
+          return false;
+        Writes.push_back(SI);
+      } else if (auto *LI = dyn_cast<LoadInst>(U)) {
+        if (LI->isVolatile())
+          return false;
+        Reads.push_back(LI);
+      } else if (auto *RMW = dyn_cast<AtomicRMWInst>(U)) {
+        if (RMW->isVolatile() || RMW->getPointerOperand() != V ||
+            !RMW->use_empty())
+          return false;
+        Writes.push_back(RMW);
+      } else if (auto *MI = dyn_cast<MemIntrinsic>(U)) {
+        if (MI->isVolatile() || MI->getRawDest() != V)
+          return false;
+        if (auto *MTI = dyn_cast<MemTransferInst>(MI))
+          if (MTI->getRawSource() == V)
+            return false;
+        Writes.push_back(MI);
+      } else if (isa<GetElementPtrInst>(U) || isa<BitCastInst>(U) ||
+                 isa<AddrSpaceCastInst>(U)) {
+        if (!collectAccesses(U, Writes, Reads, Visited))
+          return false;
+      } else if (auto *CE = dyn_cast<ConstantExpr>(U)) {
+        if (!CE->isCast() && CE->getOpcode() != Instruction::GetElementPtr)
+          return false;
+        if (!collectAccesses(CE, Writes, Reads, Visited))
+          return false;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // A load only makes the global live if its value can get out. Counters
+  // and caches read the global just to store an updated value back, so a
+  // load whose value only flows through arithmetic, casts, selects and
+  // phis into stores to the same global does not count as a read.
+  static bool feedsOnlyOwnStores(LoadInst *LI,
+                                 const SmallPtrSetImpl<Value *> &Addresses) {
+    SmallVector<Instruction *, 8> Worklist{LI};
+    SmallPtrSet<Instruction *, 8> Seen{LI};
+    while (!Worklist.empty()) {
+      Instruction *I = Worklist.pop_back_val();
+      for (User *U : I->users()) {
+        auto *UI = cast<Instruction>(U);
+        if (auto *SI = dyn_cast<StoreInst>(UI)) {
+          if (SI->getValueOperand() != I ||
+              !Addresses.count(SI->getPointerOperand()))
+            return false;
+          continue;
+        }
+        if (!isa<BinaryOperator>(UI) && !isa<CastInst>(UI) &&
+            !isa<SelectInst>(UI) && !isa<PHINode>(UI) && !isa<CmpInst>(UI))
+          return false;
+        if (Seen.insert(UI).second)
+          Worklist.push_back(UI);
+      }
+    }
+    return true;
+  }
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &) {
+    SmallVector<GlobalVariable *, 8> DeadGlobals;
+    unsigned NumStores = 0;
+
+    for (GlobalVariable &GV : M.globals()) {
+      if (!GV.hasLocalLinkage() || GV.isExternallyInitialized())
+        continue;
+
+      SmallVector<Instruction *, 8> Writes;
+      SmallVector<LoadInst *, 4> Reads;
+      SmallPtrSet<Value *, 8> Visited;
+      if (!collectAccesses(&GV, Writes, Reads, Visited) ||
+          !llvm::all_of(Reads, [&](LoadInst *LI) {
+            return feedsOnlyOwnStores(LI, Visited);
+          }))
+        continue;
+
+      if (!Writes.empty()) {
+        Instruction *First = Writes.front();
+        OptimizationRemarkEmitter ORE(First->getFunction());
+        ORE.emit([&]() {
+          return OptimizationRemark(DEBUG_TYPE, "WriteOnlyGlobal", First)
+                 << "removed " << ore::NV("Stores", (unsigned)Writes.size())
+                 << " writes to write-only global " << ore::NV("Global", &GV);
+        });
+      }
+
+      // The loaded values only reach the stores deleted below. Deleting a
+      // load or store can leave the computation of its value and address
+      // dead, e.g. the add of a counter increment or a GEP with a variable
+      // index, which would otherwise keep the global alive.
+      for (LoadInst *LI : Reads) {
+        Value *Ptr = LI->getPointerOperand();
+        LI->replaceAllUsesWith(PoisonValue::get(LI->getType()));
+        LI->eraseFromParent();
+        RecursivelyDeleteTriviallyDeadInstructions(Ptr);
+      }
+      for (Instruction *W : Writes) {
+        SmallVector<Value *, 4> Operands(W->operands());
+        W->eraseFromParent();
+        ++NumStores;
+        for (Value *Op : Operands)
+          RecursivelyDeleteTriviallyDeadInstructions(Op);
+      }
+      DeadGlobals.push_back(&GV);
+    }
+
+    // Only GEP and cast constant expressions are left as users.
+    for (GlobalVariable *GV : DeadGlobals) {
+      GV->removeDeadConstantUsers();
+      if (!GV->use_empty())
+        continue;
+      GV->eraseFromParent();
+      ++NumDeadGlobals;
+    }
+    NumDeadGlobalStores += NumStores;
+
+    if (DeadGlobals.empty())
+      return PreservedAnalyses::all();
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    return PA;
   }
 };
 
@@ -231,18 +1825,59 @@ llvmGetPassPluginInfo() {
           FAM.registerPass([] { return MemorySSAAnalysis(); });
           FAM.registerPass([] { return PostDominatorTreeAnalysis(); });
           FAM.registerPass([] { return AAManager(); });
+          FAM.registerPass([] { return TargetLibraryAnalysis(); });
+          FAM.registerPass([] { return LoopAnalysis(); });
+          FAM.registerPass([] { return DominatorTreeAnalysis(); });
+          FAM.registerPass([] { return OptimizationRemarkEmitterAnalysis(); });
         });
 
-      // Pipeline hook: -passes="require<memoryssa>,dse"
+      // Pipeline hook: -passes="require<memoryssa>,dse-mssa"
+      // The companion load pass runs as -passes="rle-mssa", or before DSE
+      // with -passes="rle-mssa,dse-mssa".
+      // "dse" is kept for old scripts, but opt resolves that name to its
+      // built-in DSEPass before asking plugins.
       PB.registerPipelineParsingCallback(
         [](StringRef Name, FunctionPassManager &FPM,
            ArrayRef<PassBuilder::PipelineElement>) {
-          if (Name == "dse") {
+          if (Name == "dse-mssa" || Name == "dse") {
             FPM.addPass(DeadStoreEliminationPass());
             return true;
           }
+          if (Name == "rle-mssa") {
+            FPM.addPass(RedundantLoadEliminationPass());
+            return true;
+          }
           return false;
         });
+
+      // Write-only globals: -passes="dse-globals" removes internal globals
+      // that are never read, with all their stores. It only needs the IR.
+      PB.registerPipelineParsingCallback(
+        [](StringRef Name, ModulePassManager &MPM,
+           ArrayRef<PassBuilder::PipelineElement>) {
+          if (Name != "dse-globals")
+            return false;
+          MPM.addPass(DeadGlobalStoreEliminationPass());
+          return true;
+        });
+
+      // Module-level mode: -passes="dse-mssa-ipo" first infers memory effects
+      // (readnone, argmemonly, inaccessiblememonly) for library declarations
+      // and for every function defined in the module, bottom-up over the
+      // call graph, so calls to helpers that cannot touch a stored location
+      // stop blocking DSE in their callers.
+      PB.registerPipelineParsingCallback(
+        [](StringRef Name, ModulePassManager &MPM,
+           ArrayRef<PassBuilder::PipelineElement>) {
+          if (Name != "dse-mssa-ipo")
+            return false;
+          MPM.addPass(InferFunctionAttrsPass());
+          MPM.addPass(createModuleToPostOrderCGSCCPassAdaptor(
+              PostOrderFunctionAttrsPass()));
+          MPM.addPass(
+              createModuleToFunctionPassAdaptor(DeadStoreEliminationPass()));
+          return true;
+        });
     }
   };
 }
@@ -0,0 +1,404 @@
+// MemorySSABatchDriver.cpp
+// Runs a pass pipeline from the A4 plugins over many IR files in one process
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace llvm;
+
+// The plugins are loaded before the command line is parsed, so that their
+// options (-dse-backward-sweep, -memssa-stats-walk-limit, ...) are known.
+// This list only documents the option; see loadPlugins().
+static cl::list<std::string> PluginPaths(
+    "load-pass-plugin", cl::desc("Load a pass plugin (may be repeated)"),
+    cl::value_desc("plugin.so"));
+
+static cl::opt<std::string> Passes(
+    "passes", cl::init("dse-mssa"),
+    cl::desc("Pass pipeline to run on every file, as for opt -passes"));
+
+static cl::list<std::string> InputFiles(
+    cl::Positional, cl::OneOrMore,
+    cl::desc("<input .bc/.ll files, or @file with one path per line>"));
+
+static cl::opt<unsigned> Jobs(
+    "j", cl::init(0), cl::Prefix,
+    cl::desc("Worker threads (default: one per hardware thread)"));
+
+static cl::opt<std::string> OutputDir(
+    "o", cl::init(""), cl::value_desc("dir"),
+    cl::desc("Write each transformed module to this directory"));
+
+static cl::opt<bool> OutputAssembly(
+    "S", cl::init(false), cl::desc("Write modules as .ll instead of .bc"));
+
+static cl::opt<std::string> ReportFile(
+    "report", cl::init(""), cl::value_desc("file.json"),
+    cl::desc("Write per-file results, totals and pass statistics as JSON"));
+
+static cl::opt<bool> VerifyEach(
+    "verify", cl::init(true),
+    cl::desc("Verify every module after the pipeline"));
+
+static cl::opt<unsigned> SlowestFiles(
+    "slowest", cl::init(10),
+    cl::desc("List this many files with the longest pipeline time"));
+
+namespace {
+
+struct IRCounts {
+  uint64_t Instructions = 0, Loads = 0, Stores = 0;
+
+  static IRCounts of(const Module &M) {
+    IRCounts C;
+    for (const Function &F : M)
+      for (const BasicBlock &BB : F)
+        for (const Instruction &I : BB) {
+          ++C.Instructions;
+          if (isa<LoadInst>(I))
+            ++C.Loads;
+          else if (isa<StoreInst>(I))
+            ++C.Stores;
+        }
+    return C;
+  }
+};
+
+struct FileResult {
+  std::string Input, Output, Error;
+  IRCounts Before, After;
+  double ParseSeconds = 0.0, PipelineSeconds = 0.0;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point Start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       Start)
+      .count();
+}
+
+// One file, start to end, in the calling worker's own LLVMContext. The
+// analysis managers are per file: nothing cached for one module is
+// reused for the next.
+void processFile(FileResult &R, LLVMContext &Ctx,
+                 ArrayRef<PassPlugin> Plugins) {
+  auto Start = std::chrono::steady_clock::now();
+  SMDiagnostic Diag;
+  std::unique_ptr<Module> M = parseIRFile(R.Input, Diag, Ctx);
+  R.ParseSeconds = secondsSince(Start);
+  if (!M) {
+    raw_string_ostream OS(R.Error);
+    Diag.print(nullptr, OS, /*ShowColors=*/false);
+    return;
+  }
+  R.Before = IRCounts::of(*M);
+
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+  PassBuilder PB;
+  for (const PassPlugin &P : Plugins)
+    P.registerPassBuilderCallbacks(PB);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  ModulePassManager MPM;
+  if (Error E = PB.parsePassPipeline(MPM, Passes)) {
+    R.Error = toString(std::move(E));
+    return;
+  }
+
+  Start = std::chrono::steady_clock::now();
+  MPM.run(*M, MAM);
+  R.PipelineSeconds = secondsSince(Start);
+  R.After = IRCounts::of(*M);
+
+  if (VerifyEach) {
+    raw_string_ostream OS(R.Error);
+    if (verifyModule(*M, &OS)) {
+      OS.flush();
+      R.Error = "module is broken after the pipeline:\n" + R.Error;
+      return;
+    }
+  }
+
+  if (R.Output.empty())
+    return;
+  std::error_code EC;
+  raw_fd_ostream OS(R.Output, EC,
+                    OutputAssembly ? sys::fs::OF_Text : sys::fs::OF_None);
+  if (EC) {
+    R.Error = "could not open " + R.Output + ": " + EC.message();
+    return;
+  }
+  if (OutputAssembly)
+    M->print(OS, nullptr);
+  else
+    WriteBitcodeToFile(*M, OS);
+}
+
+// Passes that print to stderr, or write a file whose name does not depend
+// on the module, every time they run. From several workers at once their
+// output interleaves or overwrites itself, so they need -j 1.
+const char *const SerialOnlyPasses[] = {"memssa-demo", "memssa-stats",
+                                        "memssa-graph-vis", "memssa-export"};
+
+// The first pass name in Pipeline that needs -j 1, or "" if there is none.
+StringRef findSerialOnlyPass(StringRef Pipeline) {
+  while (!Pipeline.empty()) {
+    size_t End = Pipeline.find_first_of("(),<>");
+    StringRef Name = Pipeline.take_front(End).trim();
+    Pipeline = Pipeline.drop_front(End == StringRef::npos ? Pipeline.size()
+                                                          : End + 1);
+    if (Name.starts_with("print") || is_contained(SerialOnlyPasses, Name))
+      return Name;
+  }
+  return "";
+}
+
+// <dir>/<stem>.bc, with .1, .2, ... added when two inputs share a stem.
+void assignOutputNames(MutableArrayRef<FileResult> Results) {
+  StringMap<unsigned> Seen;
+  for (FileResult &R : Results) {
+    std::string Stem = sys::path::stem(R.Input).str();
+    unsigned N = Seen[Stem]++;
+    if (N)
+      Stem += "." + std::to_string(N);
+    SmallString<256> Path(OutputDir);
+    sys::path::append(Path, Stem + (OutputAssembly ? ".ll" : ".bc"));
+    R.Output = std::string(Path);
+  }
+}
+
+// Loads every -load-pass-plugin given in argv. Must run before
+// cl::ParseCommandLineOptions, as opt does.
+bool loadPlugins(int argc, char **argv, std::vector<PassPlugin> &Plugins) {
+  StringRef Flag = "-load-pass-plugin";
+  for (int I = 1; I < argc; ++I) {
+    StringRef Arg = argv[I];
+    if (Arg.consume_front("-"))
+      Arg.consume_front("-"); // --load-pass-plugin
+    else
+      continue;
+    std::string Path;
+    if (Arg == Flag.drop_front() && I + 1 < argc)
+      Path = argv[++I];
+    else if (Arg.consume_front(Flag.drop_front()) && Arg.consume_front("="))
+      Path = Arg.str();
+    else
+      continue;
+
+    Expected<PassPlugin> P = PassPlugin::Load(Path);
+    if (!P) {
+      errs() << "Error: Failed to load plugin " << Path << ": "
+             << toString(P.takeError()) << "\n";
+      return false;
+    }
+    Plugins.push_back(*P);
+  }
+  return true;
+}
+
+void writeReport(ArrayRef<FileResult> Results, const IRCounts &Before,
+                 const IRCounts &After, double WallSeconds, unsigned Workers) {
+  std::error_code EC;
+  raw_fd_ostream OS(ReportFile, EC, sys::fs::OF_Text);
+  if (EC) {
+    errs() << "Error: Could not open file " << ReportFile << ": "
+           << EC.message() << "\n";
+    return;
+  }
+
+  auto Counts = [](json::OStream &J, const IRCounts &C) {
+    J.object([&] {
+      J.attribute("instructions", int64_t(C.Instructions));
+      J.attribute("loads", int64_t(C.Loads));
+      J.attribute("stores", int64_t(C.Stores));
+    });
+  };
+
+  json::OStream J(OS, 1);
+  J.object([&] {
+    J.attribute("passes", Passes);
+    J.attribute("workers", int64_t(Workers));
+    J.attribute("wall_seconds", WallSeconds);
+    J.attributeObject("total", [&] {
+      J.attribute("files", int64_t(Results.size()));
+      J.attributeBegin("before");
+      Counts(J, Before);
+      J.attributeEnd();
+      J.attributeBegin("after");
+      Counts(J, After);
+      J.attributeEnd();
+    });
+    J.attributeArray("files", [&] {
+      for (const FileResult &R : Results)
+        J.object([&] {
+          J.attribute("input", R.Input);
+          if (!R.Output.empty() && R.Error.empty())
+            J.attribute("output", R.Output);
+          if (!R.Error.empty())
+            J.attribute("error", R.Error);
+          J.attribute("parse_seconds", R.ParseSeconds);
+          J.attribute("pipeline_seconds", R.PipelineSeconds);
+          J.attributeBegin("before");
+          Counts(J, R.Before);
+          J.attributeEnd();
+          J.attributeBegin("after");
+          Counts(J, R.After);
+          J.attributeEnd();
+        });
+    });
+    // STATISTIC counters of all passes, summed over every file.
+    J.attributeBegin("statistics");
+    J.rawValue([](raw_ostream &OS) { PrintStatisticsJSON(OS); });
+    J.attributeEnd();
+  });
+  OS << "\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+
+  std::vector<PassPlugin> Plugins;
+  if (!loadPlugins(argc, argv, Plugins))
+    return 1;
+
+  cl::ParseCommandLineOptions(
+      argc, argv,
+      "Runs a pass pipeline over many IR files on a thread pool.\n\n"
+      "  mssa-batch -load-pass-plugin=./libDeadStoreElimination.so \\\n"
+      "      -passes=dse-mssa -o out/ -report=report.json @files.txt\n");
+  EnableStatistics(/*DoPrintOnExit=*/false);
+
+  if (!OutputDir.empty()) {
+    if (std::error_code EC = sys::fs::create_directories(OutputDir)) {
+      errs() << "Error: Could not create " << OutputDir << ": "
+             << EC.message() << "\n";
+      return 1;
+    }
+  }
+
+  std::vector<FileResult> Results(InputFiles.size());
+  for (unsigned I = 0; I < InputFiles.size(); ++I)
+    Results[I].Input = InputFiles[I];
+  if (!OutputDir.empty())
+    assignOutputNames(Results);
+
+  unsigned Workers = Jobs ? Jobs.getValue()
+                          : std::max(1u, std::thread::hardware_concurrency());
+  Workers = std::min<size_t>(Workers, Results.size());
+  if (Workers > 1) {
+    StringRef Pass = findSerialOnlyPass(Passes);
+    if (!Pass.empty()) {
+      errs() << "Error: " << Pass
+             << " writes to stderr or to a fixed file for every module; "
+                "run it with -j 1\n";
+      return 1;
+    }
+  }
+
+  // Workers take the next file from a shared counter, so a few large
+  // files do not leave the other threads idle.
+  std::atomic<size_t> Next{0};
+  std::atomic<size_t> Done{0};
+  std::mutex ProgressLock;
+  auto Work = [&] {
+    LLVMContext Ctx;
+    for (size_t I = Next++; I < Results.size(); I = Next++) {
+      processFile(Results[I], Ctx, Plugins);
+      size_t N = ++Done;
+      if (!Results[I].Error.empty()) {
+        std::lock_guard<std::mutex> Guard(ProgressLock);
+        errs() << "Error: " << Results[I].Input << ": " << Results[I].Error
+               << "\n";
+      } else if (N % 100 == 0) {
+        std::lock_guard<std::mutex> Guard(ProgressLock);
+        errs() << N << "/" << Results.size() << " files done\n";
+      }
+    }
+  };
+
+  auto Start = std::chrono::steady_clock::now();
+  std::vector<std::thread> Threads;
+  for (unsigned T = 1; T < Workers; ++T)
+    Threads.emplace_back(Work);
+  Work();
+  for (std::thread &T : Threads)
+    T.join();
+  double WallSeconds = secondsSince(Start);
+
+  IRCounts Before, After;
+  unsigned Failed = 0;
+  double CPUSeconds = 0.0;
+  for (const FileResult &R : Results) {
+    CPUSeconds += R.ParseSeconds + R.PipelineSeconds;
+    if (!R.Error.empty()) {
+      ++Failed;
+      continue;
+    }
+    Before.Instructions += R.Before.Instructions;
+    Before.Loads += R.Before.Loads;
+    Before.Stores += R.Before.Stores;
+    After.Instructions += R.After.Instructions;
+    After.Loads += R.After.Loads;
+    After.Stores += R.After.Stores;
+  }
+
+  outs() << "Files: " << Results.size() - Failed << " ok, " << Failed
+         << " failed, " << Workers << " workers\n";
+  outs() << format("Time: %.3f s wall, %.3f s summed over files (x%.1f)\n",
+                   WallSeconds, CPUSeconds,
+                   WallSeconds > 0 ? CPUSeconds / WallSeconds : 0.0);
+  outs() << "Instructions: " << Before.Instructions << " -> "
+         << After.Instructions << "\n";
+  outs() << "Loads: " << Before.Loads << " -> " << After.Loads << "\n";
+  outs() << "Stores: " << Before.Stores << " -> " << After.Stores << "\n";
+
+  std::vector<const FileResult *> Slowest;
+  for (const FileResult &R : Results)
+    if (R.Error.empty())
+      Slowest.push_back(&R);
+  llvm::sort(Slowest, [](const FileResult *A, const FileResult *B) {
+    return A->PipelineSeconds > B->PipelineSeconds;
+  });
+  if (Slowest.size() > SlowestFiles)
+    Slowest.resize(SlowestFiles);
+  if (!Slowest.empty())
+    outs() << "Slowest files:\n";
+  for (const FileResult *R : Slowest)
+    outs() << format("  %8.3f s  ", R->PipelineSeconds) << R->Input << "\n";
+
+  if (!ReportFile.empty()) {
+    writeReport(Results, Before, After, WallSeconds, Workers);
+    outs() << "Report written to: " << ReportFile << "\n";
+  }
+  return Failed ? 1 : 0;
+}
@@ -4,6 +4,19 @@
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+#include <chrono>
 
 using namespace llvm;
 
@@ -46,6 +59,315 @@ struct MemorySSADemoPass : PassInfoMixin<MemorySSADemoPass> {
   }
 };
 
+// ---------------------------------------------------------------------------
+// MemorySSA statistics: the shape of MemorySSA for a function and what the
+// walker pays to answer clobber queries on it. Used to pick walker budgets
+// and to find functions where MemorySSA based passes blow up.
+// ---------------------------------------------------------------------------
+
+#define DEBUG_TYPE "memssa-stats"
+
+// Module-independent totals, so a run over many files (see
+// MemorySSABatchDriver.cpp) adds up without reading every JSON file.
+STATISTIC(NumStatsDefs, "The # of MemoryDefs seen by memssa-stats");
+STATISTIC(NumStatsUses, "The # of MemoryUses seen by memssa-stats");
+STATISTIC(NumStatsPhis, "The # of MemoryPhis seen by memssa-stats");
+STATISTIC(NumStatsQueries, "The # of walker queries made by memssa-stats");
+STATISTIC(NumStatsDefsOptimized,
+          "The # of MemoryDefs already optimized when queried");
+STATISTIC(NumStatsWalkSteps, "The # of accesses visited by counted walks");
+
+static cl::opt<unsigned> StatsWalkLimit(
+    "memssa-stats-walk-limit", cl::init(100),
+    cl::desc("memssa-stats: stop counting a walk after this many accesses "
+             "(matches -memssa-check-limit)"));
+
+static cl::opt<std::string> StatsJSON(
+    "memssa-stats-json", cl::init(""),
+    cl::desc("memssa-stats: also write the statistics to this JSON file"));
+
+static cl::opt<unsigned> StatsTop(
+    "memssa-stats-top", cl::init(10),
+    cl::desc("memssa-stats: list this many functions with the most walk "
+             "steps"));
+
+// Power-of-two histogram: bucket 0 holds 0, bucket k holds [2^(k-1), 2^k).
+struct Histogram {
+  SmallVector<uint64_t, 16> Buckets;
+  uint64_t Count = 0, Sum = 0, Max = 0;
+
+  void add(uint64_t V) {
+    unsigned B = V == 0 ? 0 : Log2_64(V) + 1;
+    if (Buckets.size() <= B)
+      Buckets.resize(B + 1);
+    ++Buckets[B];
+    ++Count;
+    Sum += V;
+    Max = std::max(Max, V);
+  }
+
+  void merge(const Histogram &Other) {
+    if (Buckets.size() < Other.Buckets.size())
+      Buckets.resize(Other.Buckets.size());
+    for (unsigned B = 0; B < Other.Buckets.size(); ++B)
+      Buckets[B] += Other.Buckets[B];
+    Count += Other.Count;
+    Sum += Other.Sum;
+    Max = std::max(Max, Other.Max);
+  }
+
+  double mean() const { return Count ? double(Sum) / Count : 0.0; }
+
+  static uint64_t bucketLow(unsigned B) { return B == 0 ? 0 : 1ull << (B - 1); }
+  static uint64_t bucketHigh(unsigned B) { return B == 0 ? 0 : (1ull << B) - 1; }
+
+  void print(raw_ostream &OS, StringRef Title) const {
+    OS << Title << ": n=" << Count << " mean=" << format("%.2f", mean())
+       << " max=" << Max << "\n";
+    if (Count == 0)
+      return;
+    uint64_t Peak = *std::max_element(Buckets.begin(), Buckets.end());
+    for (unsigned B = 0; B < Buckets.size(); ++B) {
+      if (!Buckets[B])
+        continue;
+      OS << format("  %8llu-%-8llu %10llu ", bucketLow(B), bucketHigh(B),
+                   Buckets[B])
+         << std::string(Peak ? (Buckets[B] * 40 + Peak - 1) / Peak : 0, '#')
+         << "\n";
+    }
+  }
+
+  void toJSON(json::OStream &J) const {
+    J.object([&] {
+      J.attribute("count", int64_t(Count));
+      J.attribute("sum", int64_t(Sum));
+      J.attribute("max", int64_t(Max));
+      J.attributeArray("buckets", [&] {
+        for (unsigned B = 0; B < Buckets.size(); ++B)
+          J.array([&] {
+            J.value(int64_t(bucketLow(B)));
+            J.value(int64_t(bucketHigh(B)));
+            J.value(int64_t(Buckets[B]));
+          });
+      });
+    });
+  }
+};
+
+struct MemorySSAStats {
+  uint64_t NumDefs = 0, NumUses = 0, NumPhis = 0;
+  // Defs from each MemoryDef up to the nearest MemoryPhi or liveOnEntry.
+  Histogram DefChainLength;
+  // Incoming values per MemoryPhi.
+  Histogram PhiFanIn;
+  // Accesses an uncached upward walk visits to find each clobber.
+  Histogram WalkSteps;
+  // MemorySSA optimizes every MemoryUse when it is built, so only the
+  // MemoryDefs show whether an earlier walker query cached the answer.
+  uint64_t NumQueries = 0, NumDefsOptimized = 0;
+  double WalkerSeconds = 0.0;
+
+  void merge(const MemorySSAStats &Other) {
+    NumDefs += Other.NumDefs;
+    NumUses += Other.NumUses;
+    NumPhis += Other.NumPhis;
+    DefChainLength.merge(Other.DefChainLength);
+    PhiFanIn.merge(Other.PhiFanIn);
+    WalkSteps.merge(Other.WalkSteps);
+    NumQueries += Other.NumQueries;
+    NumDefsOptimized += Other.NumDefsOptimized;
+    WalkerSeconds += Other.WalkerSeconds;
+  }
+
+  double defsOptimizedRate() const {
+    return NumDefs ? double(NumDefsOptimized) / NumDefs : 0.0;
+  }
+
+  void toJSON(json::OStream &J) const {
+    J.attribute("defs", int64_t(NumDefs));
+    J.attribute("uses", int64_t(NumUses));
+    J.attribute("phis", int64_t(NumPhis));
+    J.attributeBegin("def_chain_length");
+    DefChainLength.toJSON(J);
+    J.attributeEnd();
+    J.attributeBegin("phi_fan_in");
+    PhiFanIn.toJSON(J);
+    J.attributeEnd();
+    J.attributeBegin("walk_steps");
+    WalkSteps.toJSON(J);
+    J.attributeEnd();
+    J.attribute("queries", int64_t(NumQueries));
+    J.attribute("defs_optimized", int64_t(NumDefsOptimized));
+    J.attribute("walker_seconds", WalkerSeconds);
+  }
+};
+
+// The same traversal as MemorySSADemoPass, counting instead of printing.
+// Computing the statistics queries the walker for every access, which
+// optimizes (caches) them in MemorySSA as a side effect.
+struct MemorySSAStatsAnalysis : AnalysisInfoMixin<MemorySSAStatsAnalysis> {
+  using Result = MemorySSAStats;
+
+  // Accesses visited on all paths up from MA until each path meets a
+  // write that may clobber MA's location, or the walk limit.
+  static unsigned countWalkSteps(MemoryUseOrDef *MA, MemorySSA &MSSA,
+                                 BatchAAResults &BAA) {
+    auto Loc = MemoryLocation::getOrNone(MA->getMemoryInst());
+    if (!Loc)
+      return 0; // calls and fences are not walked by location
+    SmallVector<MemoryAccess *, 8> Worklist{MA->getDefiningAccess()};
+    SmallPtrSet<MemoryAccess *, 16> Visited;
+    unsigned Steps = 0;
+    while (!Worklist.empty() && Steps < StatsWalkLimit) {
+      MemoryAccess *Cur = Worklist.pop_back_val();
+      if (!Visited.insert(Cur).second)
+        continue;
+      ++Steps;
+      if (MSSA.isLiveOnEntryDef(Cur))
+        continue;
+      if (auto *MPhi = dyn_cast<MemoryPhi>(Cur)) {
+        for (auto &Op : MPhi->incoming_values())
+          Worklist.push_back(cast<MemoryAccess>(Op));
+        continue;
+      }
+      auto *MD = cast<MemoryDef>(Cur);
+      if (!isModSet(BAA.getModRefInfo(MD->getMemoryInst(), *Loc)))
+        Worklist.push_back(MD->getDefiningAccess());
+    }
+    return Steps;
+  }
+
+  Result run(Function &F, FunctionAnalysisManager &AM) {
+    auto &MSSA = AM.getResult<MemorySSAAnalysis>(F).getMSSA();
+    auto &AA = AM.getResult<AAManager>(F);
+    BatchAAResults BAA(AA);
+    MemorySSAWalker *Walker = MSSA.getWalker();
+
+    Result S;
+    DenseMap<const MemoryDef *, uint64_t> ChainLength;
+    // MemorySSA defines every access before its users in RPO.
+    ReversePostOrderTraversal<Function *> RPOT(&F);
+    for (BasicBlock *BB : RPOT) {
+      if (auto *MPhi = MSSA.getMemoryAccess(BB)) {
+        ++S.NumPhis;
+        S.PhiFanIn.add(MPhi->getNumIncomingValues());
+      }
+
+      for (auto &I : *BB) {
+        auto *MA = MSSA.getMemoryAccess(&I);
+        if (!MA)
+          continue;
+        if (auto *MD = dyn_cast<MemoryDef>(MA)) {
+          ++S.NumDefs;
+          if (MD->isOptimized())
+            ++S.NumDefsOptimized;
+          auto *Parent = dyn_cast<MemoryDef>(MD->getDefiningAccess());
+          uint64_t Len = 1;
+          if (Parent && !MSSA.isLiveOnEntryDef(Parent))
+            Len += ChainLength.lookup(Parent);
+          ChainLength[MD] = Len;
+          S.DefChainLength.add(Len);
+        } else {
+          ++S.NumUses;
+        }
+
+        S.WalkSteps.add(countWalkSteps(MA, MSSA, BAA));
+        ++S.NumQueries;
+        auto Start = std::chrono::steady_clock::now();
+        Walker->getClobberingMemoryAccess(MA);
+        S.WalkerSeconds += std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - Start)
+                               .count();
+      }
+    }
+    NumStatsDefs += S.NumDefs;
+    NumStatsUses += S.NumUses;
+    NumStatsPhis += S.NumPhis;
+    NumStatsQueries += S.NumQueries;
+    NumStatsDefsOptimized += S.NumDefsOptimized;
+    NumStatsWalkSteps += S.WalkSteps.Sum;
+    return S;
+  }
+
+private:
+  static AnalysisKey Key;
+  friend AnalysisInfoMixin<MemorySSAStatsAnalysis>;
+};
+
+AnalysisKey MemorySSAStatsAnalysis::Key;
+
+// Prints module-wide histograms and the functions with the most walk
+// steps, and writes every function's statistics to -memssa-stats-json.
+struct MemorySSAStatsPass : PassInfoMixin<MemorySSAStatsPass> {
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM) {
+    auto &FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+    MemorySSAStats Total;
+    std::vector<std::pair<Function *, const MemorySSAStats *>> PerFunction;
+    for (Function &F : M) {
+      if (F.isDeclaration())
+        continue;
+      auto &S = FAM.getResult<MemorySSAStatsAnalysis>(F);
+      Total.merge(S);
+      PerFunction.push_back({&F, &S});
+    }
+
+    errs() << "MemorySSA statistics for " << M.getModuleIdentifier() << " ("
+           << PerFunction.size() << " functions)\n";
+    errs() << "  MemoryDefs: " << Total.NumDefs
+           << "  MemoryUses: " << Total.NumUses
+           << "  MemoryPhis: " << Total.NumPhis << "\n";
+    errs() << "  Walker queries: " << Total.NumQueries
+           << "  defs already optimized: "
+           << format("%.1f%%", 100.0 * Total.defsOptimizedRate()) << "  time: "
+           << format("%.3f s", Total.WalkerSeconds) << "\n";
+    Total.DefChainLength.print(errs(), "Def chain length");
+    Total.PhiFanIn.print(errs(), "MemoryPhi fan-in");
+    Total.WalkSteps.print(errs(), "Walk steps per query");
+
+    auto Top = PerFunction;
+    llvm::sort(Top, [](const auto &A, const auto &B) {
+      return A.second->WalkSteps.Sum > B.second->WalkSteps.Sum;
+    });
+    if (Top.size() > StatsTop)
+      Top.resize(StatsTop);
+    if (!Top.empty())
+      errs() << "Functions with the most walk steps:\n";
+    for (auto &P : Top)
+      errs() << format("  %10llu steps %8llu queries %6.1f%% defs optimized  ",
+                       P.second->WalkSteps.Sum, P.second->NumQueries,
+                       100.0 * P.second->defsOptimizedRate())
+             << P.first->getName() << "\n";
+
+    if (!StatsJSON.empty()) {
+      std::error_code EC;
+      raw_fd_ostream OS(StatsJSON, EC, sys::fs::OF_Text);
+      if (EC) {
+        errs() << "Error: Could not open file " << StatsJSON << ": "
+               << EC.message() << "\n";
+        return PreservedAnalyses::all();
+      }
+      json::OStream J(OS, 1);
+      J.object([&] {
+        J.attribute("module", M.getModuleIdentifier());
+        J.attributeObject("total", [&] { Total.toJSON(J); });
+        J.attributeArray("functions", [&] {
+          for (auto &P : PerFunction)
+            J.object([&] {
+              J.attribute("name", P.first->getName());
+              P.second->toJSON(J);
+            });
+        });
+      });
+      OS << "\n";
+      errs() << "Statistics written to: " << StatsJSON << "\n";
+    }
+
+    // Only the walker's clobber caches in MemorySSA changed.
+    return PreservedAnalyses::all();
+  }
+};
+
 extern"C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
 llvmGetPassPluginInfo() {
   return {LLVM_PLUGIN_API_VERSION, "MemorySSADemoPass", "v0.9",
@@ -53,6 +375,7 @@ llvmGetPassPluginInfo() {
             PB.registerAnalysisRegistrationCallback(
                 [](FunctionAnalysisManager &FAM) {
                   FAM.registerPass([] { return MemorySSAAnalysis(); });
+                  FAM.registerPass([] { return MemorySSAStatsAnalysis(); });
                 });
 
             PB.registerPipelineParsingCallback(
@@ -64,6 +387,17 @@ llvmGetPassPluginInfo() {
                   }
                   return false;
                 });
+
+            // Module pass: -passes="memssa-stats"
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, ModulePassManager &MPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "memssa-stats") {
+                    MPM.addPass(MemorySSAStatsPass());
+                    return true;
+                  }
+                  return false;
+                });
           }};
 }
 
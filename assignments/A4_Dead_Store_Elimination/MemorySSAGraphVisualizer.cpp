@@ -1,15 +1,56 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemorySSA.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
 #include <fstream>
 #include <sstream>
 
 using namespace llvm;
 
+// Options to cut the graph down for functions too big for Graphviz. All
+// filters combine: only accesses that pass every given filter are drawn.
+// Edges from accesses outside the view end in a grey stub node.
+static cl::opt<std::string> VisFunction(
+    "memssa-vis-function", cl::init(""),
+    cl::desc("memssa-graph-vis: only draw this function"));
+
+static cl::opt<std::string> VisLoop(
+    "memssa-vis-loop", cl::init(""),
+    cl::desc("memssa-graph-vis: only draw the innermost loop containing the "
+             "block with this name"));
+
+static cl::list<std::string> VisBlocks(
+    "memssa-vis-blocks", cl::CommaSeparated,
+    cl::desc("memssa-graph-vis: only draw these blocks (comma separated)"));
+
+static cl::opt<std::string> VisSlice(
+    "memssa-vis-slice", cl::init(""),
+    cl::desc("memssa-graph-vis: only draw the def-use slice around this "
+             "access, given as a MemoryDef/MemoryPhi ID or an instruction "
+             "name"));
+
+static cl::opt<unsigned> VisDepth(
+    "memssa-vis-depth", cl::init(3),
+    cl::desc("memssa-graph-vis: how many edges the slice reaches out"));
+
+static cl::opt<unsigned> VisCollapse(
+    "memssa-vis-collapse", cl::init(0),
+    cl::desc("memssa-graph-vis: draw runs of at least this many stores "
+             "in a block that nothing reads as one summary node (0 = off)"));
+
 struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
   
   // Helper function to escape strings for DOT format
@@ -40,21 +81,210 @@ struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
     return escapeDOT(result);
   }
   
-  // Get instruction details for label
-  std::string getInstructionLabel(Instruction *I) {
+  // Get instruction details for label. One slot tracker is shared by the
+  // whole function; printing without one numbers the function again for
+  // every instruction.
+  std::string getInstructionLabel(Instruction *I, ModuleSlotTracker &MST) {
     std::string result;
     llvm::raw_string_ostream rso(result);
-    I->print(rso);
+    I->print(rso, MST);
     rso.flush();
     return escapeDOT(result);
   }
 
+  // Could not find what a filter option names.
+  static void warnNotFound(StringRef Option, StringRef Value, Function &F) {
+    errs() << "Warning: " << Option << "=" << Value << " not found in "
+           << F.getName() << ", drawing nothing\n";
+  }
+
+  // Does V print as Wanted? Unnamed blocks and instructions (clang -O0
+  // output) are matched by their slot number, with or without the '%'.
+  static bool hasName(const Value *V, StringRef Wanted,
+                      ModuleSlotTracker &MST) {
+    Wanted.consume_front("%");
+    if (V->hasName())
+      return V->getName() == Wanted;
+    int Slot = MST.getLocalSlot(V);
+    return Slot >= 0 && Wanted == std::to_string(Slot);
+  }
+
+  // Finds the access -memssa-vis-slice names: a MemoryDef/MemoryPhi ID as
+  // printed by MemorySSA, or the name of a memory instruction.
+  static MemoryAccess *findSliceStart(Function &F, MemorySSA &MSSA,
+                                      ModuleSlotTracker &MST) {
+    unsigned ID;
+    bool ByID = !StringRef(VisSlice).getAsInteger(10, ID);
+    for (auto &BB : F) {
+      if (auto *MPhi = MSSA.getMemoryAccess(&BB))
+        if (ByID && MPhi->getID() == ID)
+          return MPhi;
+      for (auto &I : BB) {
+        auto *MA = MSSA.getMemoryAccess(&I);
+        if (!MA)
+          continue;
+        if (ByID ? isa<MemoryDef>(MA) && cast<MemoryDef>(MA)->getID() == ID
+                 : hasName(&I, VisSlice, MST))
+          return MA;
+      }
+    }
+    return nullptr;
+  }
+
+  // Accesses the filter options leave in view. Returns false if no filter
+  // is given, i.e. everything is drawn.
+  bool selectAccesses(Function &F, MemorySSA &MSSA,
+                      FunctionAnalysisManager &AM, ModuleSlotTracker &MST,
+                      SmallPtrSetImpl<const MemoryAccess *> &Shown) {
+    if (VisLoop.empty() && VisBlocks.empty() && VisSlice.empty())
+      return false;
+
+    SmallPtrSet<const BasicBlock *, 32> Blocks;
+    for (auto &BB : F)
+      Blocks.insert(&BB);
+
+    if (!VisLoop.empty()) {
+      auto &LI = AM.getResult<LoopAnalysis>(F);
+      Loop *L = nullptr;
+      for (auto &BB : F)
+        if (hasName(&BB, VisLoop, MST))
+          L = LI.getLoopFor(&BB);
+      if (!L) {
+        warnNotFound("-memssa-vis-loop", VisLoop, F);
+        return true;
+      }
+      Blocks.clear();
+      Blocks.insert(L->block_begin(), L->block_end());
+    }
+
+    if (!VisBlocks.empty()) {
+      SmallPtrSet<const BasicBlock *, 32> Named;
+      for (auto &BB : F)
+        if (Blocks.count(&BB) &&
+            llvm::any_of(VisBlocks, [&](const std::string &Name) {
+              return hasName(&BB, Name, MST);
+            }))
+          Named.insert(&BB);
+      Blocks = std::move(Named);
+    }
+
+    // Breadth-first over defining accesses, phi operands and users.
+    SmallPtrSet<const MemoryAccess *, 32> Slice;
+    if (!VisSlice.empty()) {
+      MemoryAccess *Start = findSliceStart(F, MSSA, MST);
+      if (!Start) {
+        warnNotFound("-memssa-vis-slice", VisSlice, F);
+        return true;
+      }
+      SmallVector<MemoryAccess *, 16> Frontier{Start};
+      Slice.insert(Start);
+      for (unsigned Depth = 0; Depth < VisDepth && !Frontier.empty();
+           ++Depth) {
+        SmallVector<MemoryAccess *, 16> Next;
+        auto Visit = [&](MemoryAccess *MA) {
+          if (MA && Slice.insert(MA).second)
+            Next.push_back(MA);
+        };
+        for (MemoryAccess *MA : Frontier) {
+          if (auto *MUD = dyn_cast<MemoryUseOrDef>(MA))
+            Visit(MUD->getDefiningAccess());
+          else
+            for (auto &Op : cast<MemoryPhi>(MA)->incoming_values())
+              Visit(cast<MemoryAccess>(Op));
+          for (User *U : MA->users())
+            Visit(cast<MemoryAccess>(U));
+        }
+        Frontier = std::move(Next);
+      }
+    }
+
+    for (auto &BB : F) {
+      if (!Blocks.count(&BB))
+        continue;
+      if (auto *Accesses = MSSA.getBlockAccesses(&BB))
+        for (const MemoryAccess &MA : *Accesses)
+          if (VisSlice.empty() || Slice.count(&MA))
+            Shown.insert(&MA);
+    }
+    return true;
+  }
+
+  // Runs of at least VisCollapse stores in one block that no MemoryUse or
+  // MemoryPhi reads. Other MemoryDefs (calls, memcpy) may read memory
+  // themselves and always end a run. Maps every member to the first def of
+  // its run, and the first def to the run's length.
+  void findUnreadRuns(Function &F, MemorySSA &MSSA,
+                      function_ref<bool(const MemoryAccess *)> IsShown,
+                      DenseMap<const MemoryAccess *, MemoryAccess *> &RunOf,
+                      DenseMap<const MemoryAccess *, unsigned> &RunLength) {
+    for (auto &BB : F) {
+      SmallVector<MemoryAccess *, 16> Run;
+      auto EndRun = [&]() {
+        if (Run.size() >= VisCollapse) {
+          for (MemoryAccess *MA : Run)
+            RunOf[MA] = Run.front();
+          RunLength[Run.front()] = Run.size();
+        }
+        Run.clear();
+      };
+      for (auto &I : BB) {
+        auto *MD = dyn_cast_or_null<MemoryDef>(MSSA.getMemoryAccess(&I));
+        if (!MD)
+          continue; // MemoryUses are checked through the defs' users
+        bool Unread = IsShown(MD) && isa<StoreInst>(I) &&
+                      llvm::none_of(MD->users(), [](User *U) {
+                        return isa<MemoryUse>(U) || isa<MemoryPhi>(U);
+                      });
+        if (!Unread) {
+          EndRun();
+          continue;
+        }
+        Run.push_back(MD);
+      }
+      EndRun();
+    }
+  }
+
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+    if (!VisFunction.empty() && F.getName() != VisFunction)
+      return PreservedAnalyses::all();
+
     auto &MSSAResult = AM.getResult<MemorySSAAnalysis>(F);
     auto &MSSA = MSSAResult.getMSSA();
 
     errs() << "Generating MemorySSA graph for function: " << F.getName() << "\n";
 
+    ModuleSlotTracker MST(F.getParent());
+    MST.incorporateFunction(F);
+
+    // Unnamed blocks are called by their slot number, as in the IR.
+    auto BlockName = [&](const BasicBlock *BB) {
+      return BB->hasName() ? BB->getName().str()
+                           : std::to_string(MST.getLocalSlot(BB));
+    };
+
+    SmallPtrSet<const MemoryAccess *, 32> Shown;
+    bool Filtered = selectAccesses(F, MSSA, AM, MST, Shown);
+    auto IsShown = [&](const MemoryAccess *MA) {
+      return !Filtered || Shown.count(MA);
+    };
+
+    DenseMap<const MemoryAccess *, MemoryAccess *> RunOf;
+    DenseMap<const MemoryAccess *, unsigned> RunLength;
+    if (VisCollapse > 1)
+      findUnreadRuns(F, MSSA, IsShown, RunOf, RunLength);
+
+    // Node an edge to or from MA attaches to: its summary node if it is in
+    // a collapsed run. Accesses out of view get a stub node once.
+    SmallPtrSet<MemoryAccess *, 16> Outside;
+    auto NodeID = [&](MemoryAccess *MA) {
+      if (MemoryAccess *First = RunOf.lookup(MA))
+        return "S_" + getAccessID(First);
+      if (Filtered && !Shown.count(MA) && !MSSA.isLiveOnEntryDef(MA))
+        Outside.insert(MA);
+      return getAccessID(MA);
+    };
+
     // Create output filename
     std::string filename = F.getName().str() + "_memssa.dot";
     std::ofstream dotFile(filename);
@@ -76,7 +306,16 @@ struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
 
     // Process each basic block
     for (auto &BB : F) {
-      std::string bbName = BB.hasName() ? BB.getName().str() : "entry";
+      std::string bbName = BlockName(&BB);
+
+      // With a filter, blocks with nothing in view are left out.
+      if (Filtered) {
+        auto *Accesses = MSSA.getBlockAccesses(&BB);
+        if (!Accesses || llvm::none_of(*Accesses, [&](const MemoryAccess &MA) {
+              return Shown.count(&MA);
+            }))
+          continue;
+      }
       
       // Create a subgraph for each basic block
       dotFile << "  subgraph cluster_" << bbName << " {\n";
@@ -87,7 +326,8 @@ struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
 
       // Handle MemoryPhi nodes
       if (auto *Phi = MSSA.getMemoryAccess(&BB)) {
-        if (auto *MPhi = dyn_cast<MemoryPhi>(Phi)) {
+        auto *MPhi = dyn_cast<MemoryPhi>(Phi);
+        if (MPhi && IsShown(MPhi)) {
           std::string phiID = getAccessID(MPhi);
           dotFile << "    " << phiID << " [label=\"MemoryPhi\\n" 
                   << bbName << "\", shape=diamond, color=blue, style=filled, fillcolor=lightblue];\n";
@@ -96,8 +336,8 @@ struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
           for (unsigned i = 0; i < MPhi->getNumIncomingValues(); ++i) {
             auto *IncomingAcc = MPhi->getIncomingValue(i);
             auto *PredBB = MPhi->getIncomingBlock(i);
-            std::string predName = PredBB->hasName() ? PredBB->getName().str() : "pred";
-            std::string incomingID = getAccessID(IncomingAcc);
+            std::string predName = BlockName(PredBB);
+            std::string incomingID = NodeID(IncomingAcc);
             
             dotFile << "    " << incomingID << " -> " << phiID 
                     << " [label=\"from " << predName << "\", color=blue];\n";
@@ -107,34 +347,58 @@ struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
 
       // Handle MemoryDef and MemoryUse
       for (auto &I : BB) {
-        if (auto *MA = MSSA.getMemoryAccess(&I)) {
-          std::string accessID = getAccessID(MA);
-          std::string instLabel = getInstructionLabel(&I);
+        auto *MA = MSSA.getMemoryAccess(&I);
+        if (!MA || !IsShown(MA))
+          continue;
+
+        // A collapsed run is drawn once, at its first def, with the edge
+        // from the def before the run.
+        if (MemoryAccess *First = RunOf.lookup(MA)) {
+          if (First != MA)
+            continue;
+          MemoryAccess *Last = MA;
+          for (unsigned N = RunLength.lookup(MA); N > 1; --N)
+            for (User *U : Last->users())
+              if (isa<MemoryDef>(U) && RunOf.lookup(cast<MemoryAccess>(U)) == First)
+                Last = cast<MemoryAccess>(U);
+          dotFile << "    " << NodeID(MA) << " [label=\""
+                  << RunLength.lookup(MA) << " stores, none read\\n"
+                  << getInstructionLabel(&I, MST) << "\\n...\\n"
+                  << getInstructionLabel(cast<MemoryDef>(Last)->getMemoryInst(),
+                                         MST)
+                  << "\", color=red, style=\"filled,dashed\", fillcolor=mistyrose];\n";
+          auto *DefAccess = cast<MemoryDef>(MA)->getDefiningAccess();
+          dotFile << "    " << NodeID(DefAccess) << " -> " << NodeID(MA)
+                  << " [label=\"defines\", color=red, style=bold];\n";
+          continue;
+        }
+
+        std::string accessID = getAccessID(MA);
+        std::string instLabel = getInstructionLabel(&I, MST);
           
-          if (auto *MDef = dyn_cast<MemoryDef>(MA)) {
-            // MemoryDef (stores/calls that write)
-            dotFile << "    " << accessID << " [label=\"MemoryDef\\n" 
-                    << instLabel << "\", color=red, style=filled, fillcolor=lightyellow];\n";
+        if (auto *MDef = dyn_cast<MemoryDef>(MA)) {
+          // MemoryDef (stores/calls that write)
+          dotFile << "    " << accessID << " [label=\"MemoryDef\\n" 
+                  << instLabel << "\", color=red, style=filled, fillcolor=lightyellow];\n";
             
-            // Add edge to defining access
-            auto *DefAccess = MDef->getDefiningAccess();
-            if (DefAccess) {
-              std::string defID = getAccessID(DefAccess);
-              dotFile << "    " << defID << " -> " << accessID 
-                      << " [label=\"defines\", color=red, style=bold];\n";
-            }
-          } else if (auto *MUse = dyn_cast<MemoryUse>(MA)) {
-            // MemoryUse (loads)
-            dotFile << "    " << accessID << " [label=\"MemoryUse\\n" 
-                    << instLabel << "\", color=green, style=filled, fillcolor=lightgreen];\n";
+          // Add edge to defining access
+          auto *DefAccess = MDef->getDefiningAccess();
+          if (DefAccess) {
+            std::string defID = NodeID(DefAccess);
+            dotFile << "    " << defID << " -> " << accessID 
+                    << " [label=\"defines\", color=red, style=bold];\n";
+          }
+        } else if (auto *MUse = dyn_cast<MemoryUse>(MA)) {
+          // MemoryUse (loads)
+          dotFile << "    " << accessID << " [label=\"MemoryUse\\n" 
+                  << instLabel << "\", color=green, style=filled, fillcolor=lightgreen];\n";
             
-            // Add edge to defining access
-            auto *DefAccess = MUse->getDefiningAccess();
-            if (DefAccess) {
-              std::string defID = getAccessID(DefAccess);
-              dotFile << "    " << defID << " -> " << accessID 
-                      << " [label=\"used by\", color=green, style=dashed];\n";
-            }
+          // Add edge to defining access
+          auto *DefAccess = MUse->getDefiningAccess();
+          if (DefAccess) {
+            std::string defID = NodeID(DefAccess);
+            dotFile << "    " << defID << " -> " << accessID 
+                    << " [label=\"used by\", color=green, style=dashed];\n";
           }
         }
       }
@@ -142,6 +406,12 @@ struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
       dotFile << "  }\n\n";
     }
 
+    // Stubs for the accesses edges come from outside the view
+    for (MemoryAccess *MA : Outside)
+      dotFile << "  " << getAccessID(MA) << " [label=\""
+              << getAccessLabel(MA) << "\\n(not shown)\", shape=plaintext, "
+              << "fontcolor=gray];\n";
+
     // Close the graph
     dotFile << "}\n";
     dotFile.close();
@@ -158,7 +428,8 @@ struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
       errs() << "BasicBlock: " << BB.getName() << "\n";
 
       if (auto *Phi = MSSA.getMemoryAccess(&BB)) {
-        if (auto *MPhi = dyn_cast<MemoryPhi>(Phi)) {
+        auto *MPhi = dyn_cast<MemoryPhi>(Phi);
+        if (MPhi && IsShown(MPhi)) {
           errs() << "  MemoryPhi for block " << BB.getName() << ":\n";
           for (unsigned i = 0; i < MPhi->getNumIncomingValues(); ++i) {
             auto *IncomingAcc = MPhi->getIncomingValue(i);
@@ -171,7 +442,8 @@ struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
       }
 
       for (auto &I : BB) {
-        if (auto *MA = MSSA.getMemoryAccess(&I)) {
+        auto *MA = MSSA.getMemoryAccess(&I);
+        if (MA && IsShown(MA)) {
           errs() << "  ";
           MA->print(errs());
           errs() << " -> ";
@@ -185,6 +457,266 @@ struct MemorySSAGraphVisPass : PassInfoMixin<MemorySSAGraphVisPass> {
   }
 };
 
+// Streaming export of MemorySSA for large modules: one file per module, no
+// instruction printing, and MemorySSA's own access IDs instead of pointer
+// strings. MemoryUses have no ID in MemorySSA, so they are numbered after
+// the highest MemoryDef/MemoryPhi ID of their function.
+//
+// JSON (default):
+//   {"module": ..., "functions": [
+//     {"name": ..., "blocks": [names], "accesses": [
+//       {"id": 0, "kind": "liveOnEntry"},
+//       {"id": 1, "kind": "def", "block": 0, "inst": 3, "op": "store",
+//        "defining": 0},
+//       {"id": 2, "kind": "phi", "block": 2, "incoming": [[1, 0], [0, 1]]},
+//       ...]}, ...],
+//    "index": [{"name": ..., "offset": <byte offset of the function>,
+//               "accesses": n}, ...]}
+//
+// Binary (-memssa-export-format=binary), all integers little endian:
+//   "MSSA" u32 version u32 #functions
+//   per function: str name, u32 #blocks, u32 #accesses, then per access
+//     u32 id, u8 kind (0 liveOnEntry, 1 def, 2 use, 3 phi), u32 block,
+//     u32 inst, u32 opcode, and u32 defining for def/use or
+//     u32 n, n x (u32 incoming id, u32 block) for a phi
+//   index: u32 #functions, per function str name, u64 offset, u32 #accesses
+//   trailer: u64 offset of the index, "MSSI"
+// where str is u32 length + bytes and inst/block are ~0u when absent.
+
+enum class MemorySSAExportFormat { JSON, Binary };
+
+static cl::opt<MemorySSAExportFormat> ExportFormat(
+    "memssa-export-format", cl::init(MemorySSAExportFormat::JSON),
+    cl::desc("memssa-export: output format"),
+    cl::values(clEnumValN(MemorySSAExportFormat::JSON, "json",
+                          "JSON with a per-function byte offset index"),
+               clEnumValN(MemorySSAExportFormat::Binary, "binary",
+                          "compact little-endian adjacency records")));
+
+static cl::opt<std::string> ExportFile(
+    "memssa-export-file", cl::init(""),
+    cl::desc("memssa-export: output path (default: <module>.memssa.json or "
+             "<module>.memssa.bin in the current directory)"));
+
+struct MemorySSAExportPass : PassInfoMixin<MemorySSAExportPass> {
+
+  enum AccessKind : uint8_t { LiveOnEntry, Def, Use, Phi };
+
+  struct IndexEntry {
+    std::string Name;
+    uint64_t Offset;
+    uint32_t NumAccesses;
+  };
+
+  // Numbers the blocks and memory instructions of F and gives every
+  // MemoryUse an ID above the MemoryDef/MemoryPhi IDs.
+  struct FunctionNumbering {
+    DenseMap<const BasicBlock *, uint32_t> BlockIdx;
+    DenseMap<const MemoryAccess *, uint32_t> UseID;
+    uint32_t NumAccesses = 1; // liveOnEntry
+
+    FunctionNumbering(Function &F, MemorySSA &MSSA) {
+      uint32_t MaxID = 0, NextBlock = 0;
+      SmallVector<const MemoryAccess *, 32> Uses;
+      for (BasicBlock &BB : F) {
+        BlockIdx[&BB] = NextBlock++;
+        if (auto *Accesses = MSSA.getBlockAccesses(&BB))
+          for (const MemoryAccess &MA : *Accesses) {
+            ++NumAccesses;
+            if (isa<MemoryUse>(MA))
+              Uses.push_back(&MA);
+            else
+              MaxID = std::max(MaxID, getID(&MA));
+          }
+      }
+      for (const MemoryAccess *MA : Uses)
+        UseID[MA] = ++MaxID;
+    }
+
+    static uint32_t getID(const MemoryAccess *MA) {
+      if (const auto *MD = dyn_cast<MemoryDef>(MA))
+        return MD->getID();
+      return cast<MemoryPhi>(MA)->getID();
+    }
+
+    uint32_t id(const MemoryAccess *MA) const {
+      if (isa<MemoryUse>(MA))
+        return UseID.lookup(MA);
+      return getID(MA);
+    }
+  };
+
+  // Calls Visit(MA, Kind, BlockIdx, InstIdx) for every access of F in block
+  // order, liveOnEntry first.
+  template <typename VisitFn>
+  static void forEachAccess(Function &F, MemorySSA &MSSA,
+                            const FunctionNumbering &N, VisitFn Visit) {
+    Visit(MSSA.getLiveOnEntryDef(), LiveOnEntry, ~0u, ~0u);
+    uint32_t InstIdx = 0;
+    for (BasicBlock &BB : F) {
+      uint32_t B = N.BlockIdx.lookup(&BB);
+      if (auto *MPhi = MSSA.getMemoryAccess(&BB))
+        Visit(MPhi, Phi, B, ~0u);
+      for (Instruction &I : BB) {
+        if (auto *MA = MSSA.getMemoryAccess(&I))
+          Visit(MA, isa<MemoryDef>(MA) ? Def : Use, B, InstIdx);
+        ++InstIdx;
+      }
+    }
+  }
+
+  static void writeJSON(raw_fd_ostream &OS, Function &F, MemorySSA &MSSA,
+                        const FunctionNumbering &N) {
+    static const char *KindName[] = {"liveOnEntry", "def", "use", "phi"};
+    json::OStream J(OS);
+    J.object([&] {
+      J.attribute("name", F.getName());
+      J.attributeArray("blocks", [&] {
+        for (BasicBlock &BB : F)
+          J.value(BB.getName());
+      });
+      J.attributeArray("accesses", [&] {
+        forEachAccess(F, MSSA, N, [&](MemoryAccess *MA, AccessKind Kind,
+                                      uint32_t Block, uint32_t Inst) {
+          J.object([&] {
+            J.attribute("id", N.id(MA));
+            J.attribute("kind", KindName[Kind]);
+            if (Kind == LiveOnEntry)
+              return;
+            J.attribute("block", Block);
+            if (auto *MUD = dyn_cast<MemoryUseOrDef>(MA)) {
+              J.attribute("inst", Inst);
+              J.attribute("op", MUD->getMemoryInst()->getOpcodeName());
+              J.attribute("defining", N.id(MUD->getDefiningAccess()));
+              return;
+            }
+            auto *MPhi = cast<MemoryPhi>(MA);
+            J.attributeArray("incoming", [&] {
+              for (unsigned I = 0, E = MPhi->getNumIncomingValues(); I != E;
+                   ++I)
+                J.array([&] {
+                  J.value(N.id(MPhi->getIncomingValue(I)));
+                  J.value(N.BlockIdx.lookup(MPhi->getIncomingBlock(I)));
+                });
+            });
+          });
+        });
+      });
+    });
+  }
+
+  static void writeString(support::endian::Writer &W, StringRef S) {
+    W.write<uint32_t>(S.size());
+    W.OS << S;
+  }
+
+  static void writeBinary(raw_fd_ostream &OS, Function &F, MemorySSA &MSSA,
+                          const FunctionNumbering &N) {
+    support::endian::Writer W(OS, llvm::endianness::little);
+    writeString(W, F.getName());
+    W.write<uint32_t>(F.size());
+    W.write<uint32_t>(N.NumAccesses);
+    forEachAccess(F, MSSA, N, [&](MemoryAccess *MA, AccessKind Kind,
+                                  uint32_t Block, uint32_t Inst) {
+      W.write<uint32_t>(N.id(MA));
+      W.write<uint8_t>(Kind);
+      W.write<uint32_t>(Block);
+      W.write<uint32_t>(Inst);
+      if (auto *MPhi = dyn_cast<MemoryPhi>(MA)) {
+        W.write<uint32_t>(0);
+        W.write<uint32_t>(MPhi->getNumIncomingValues());
+        for (unsigned I = 0, E = MPhi->getNumIncomingValues(); I != E; ++I) {
+          W.write<uint32_t>(N.id(MPhi->getIncomingValue(I)));
+          W.write<uint32_t>(N.BlockIdx.lookup(MPhi->getIncomingBlock(I)));
+        }
+        return;
+      }
+      auto *MUD = dyn_cast<MemoryUseOrDef>(MA);
+      bool IsLiveOnEntry = Kind == LiveOnEntry;
+      W.write<uint32_t>(IsLiveOnEntry ? 0 : MUD->getMemoryInst()->getOpcode());
+      W.write<uint32_t>(IsLiveOnEntry ? ~0u
+                                      : N.id(MUD->getDefiningAccess()));
+    });
+  }
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM) {
+    auto &FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+    bool Binary = ExportFormat == MemorySSAExportFormat::Binary;
+
+    std::string Filename = ExportFile;
+    if (Filename.empty()) {
+      StringRef Stem = sys::path::stem(M.getSourceFileName());
+      Filename = (Stem.empty() ? StringRef("module") : Stem).str() +
+                 (Binary ? ".memssa.bin" : ".memssa.json");
+    }
+
+    std::error_code EC;
+    raw_fd_ostream OS(Filename, EC,
+                      Binary ? sys::fs::OF_None : sys::fs::OF_Text);
+    if (EC) {
+      errs() << "Error: Could not open file " << Filename << ": "
+             << EC.message() << "\n";
+      return PreservedAnalyses::all();
+    }
+
+    std::vector<IndexEntry> Index;
+    support::endian::Writer W(OS, llvm::endianness::little);
+    if (Binary) {
+      OS << "MSSA";
+      W.write<uint32_t>(1);
+      uint32_t NumDefined = llvm::count_if(
+          M, [](const Function &F) { return !F.isDeclaration(); });
+      W.write<uint32_t>(NumDefined);
+    } else {
+      OS << "{\"module\": ";
+      json::OStream(OS).value(M.getModuleIdentifier());
+      OS << ",\n\"functions\": [\n";
+    }
+
+    for (Function &F : M) {
+      if (F.isDeclaration())
+        continue;
+      auto &MSSA = FAM.getResult<MemorySSAAnalysis>(F).getMSSA();
+      FunctionNumbering N(F, MSSA);
+      if (!Binary && !Index.empty())
+        OS << ",\n";
+      Index.push_back({F.getName().str(), OS.tell(), N.NumAccesses});
+      if (Binary)
+        writeBinary(OS, F, MSSA, N);
+      else
+        writeJSON(OS, F, MSSA, N);
+    }
+
+    uint64_t IndexOffset = OS.tell();
+    if (Binary) {
+      W.write<uint32_t>(Index.size());
+      for (IndexEntry &E : Index) {
+        writeString(W, E.Name);
+        W.write<uint64_t>(E.Offset);
+        W.write<uint32_t>(E.NumAccesses);
+      }
+      W.write<uint64_t>(IndexOffset);
+      OS << "MSSI";
+    } else {
+      OS << "],\n\"index\": ";
+      json::OStream J(OS);
+      J.array([&] {
+        for (IndexEntry &E : Index)
+          J.object([&] {
+            J.attribute("name", E.Name);
+            J.attribute("offset", int64_t(E.Offset));
+            J.attribute("accesses", E.NumAccesses);
+          });
+      });
+      OS << "}\n";
+    }
+
+    errs() << "MemorySSA of " << Index.size() << " functions written to: "
+           << Filename << "\n";
+    return PreservedAnalyses::all();
+  }
+};
+
 extern"C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
 llvmGetPassPluginInfo() {
   return {LLVM_PLUGIN_API_VERSION, "MemorySSAGraphVisPass", "v1.0",
@@ -192,6 +724,7 @@ llvmGetPassPluginInfo() {
             PB.registerAnalysisRegistrationCallback(
                 [](FunctionAnalysisManager &FAM) {
                   FAM.registerPass([] { return MemorySSAAnalysis(); });
+                  FAM.registerPass([] { return LoopAnalysis(); });
                 });
 
             PB.registerPipelineParsingCallback(
@@ -203,5 +736,16 @@ llvmGetPassPluginInfo() {
                   }
                   return false;
                 });
+
+            // Module pass: one JSON or binary file for the whole module.
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, ModulePassManager &MPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "memssa-export") {
+                    MPM.addPass(MemorySSAExportPass());
+                    return true;
+                  }
+                  return false;
+                });
           }};
 }
\ No newline at end of file
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+"""Differential benchmark of the DSE plugin against LLVM's built-in dse.
+
+Generates a module of N functions with M stores each, where a share of
+the stores sits in if/else diamonds (--branch-density) and a share goes
+through two pointer arguments that main sometimes passes the same buffer
+for (--alias-ambiguity). The module is run through opt three times:
+without DSE, with the plugin's pass and with the stock dse. For each run
+it reports the stores left and removed, the opt time and the peak memory
+of the opt process.
+
+Every function is called from main, which prints a checksum of the two
+buffers after each call. All three modules are executed with lli and
+their output must be the same, otherwise the run is reported as a
+MISMATCH and the script exits with status 1.
+
+Note that opt resolves -passes=dse to the built-in pass before it asks
+plugins, which is why the plugin's pass is run as dse-mssa.
+
+Usage:
+    python3 dse_compare.py --plugin ./libDeadStoreElimination.so
+    python3 dse_compare.py --plugin ./libDeadStoreElimination.so \
+        --stores 500,2000,8000 --functions 50 --branch-density 0.1 \
+        --alias-ambiguity 0.3 --plugin-flags "-dse-backward-sweep"
+"""
+
+import argparse
+import os
+import random
+import shlex
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def gen_function(name, num_stores, num_slots, branch_density,
+                 alias_ambiguity, rng):
+    """Stores into a local array and into two pointer arguments %p and %q,
+    ending with a read of some array slots whose sum goes to %q."""
+    lines = [f"define void @{name}(ptr %p, ptr %q, i32 %c) {{",
+             "entry:",
+             f"  %arr = alloca [{num_slots} x i32], align 4",
+             f"  call void @llvm.memset.p0.i64(ptr %arr, i8 0, "
+             f"i64 {4 * num_slots}, i1 false)"]
+    tmp = 0
+
+    def address():
+        nonlocal tmp
+        tmp += 1
+        if rng.random() < alias_ambiguity:
+            base = rng.choice(["%p", "%q"])
+            lines.append(f"  %a{tmp} = getelementptr inbounds i32, "
+                         f"ptr {base}, i64 {rng.randrange(num_slots)}")
+        else:
+            lines.append(f"  %a{tmp} = getelementptr inbounds "
+                         f"[{num_slots} x i32], ptr %arr, i64 0, "
+                         f"i64 {rng.randrange(num_slots)}")
+        return f"%a{tmp}"
+
+    def value(i):
+        nonlocal tmp
+        if rng.random() < 0.15:
+            src = address()
+            tmp += 1
+            lines.append(f"  %v{tmp} = load i32, ptr {src}, align 4")
+            lines.append(f"  %w{tmp} = add i32 %v{tmp}, {i}")
+            return f"%w{tmp}"
+        return str(i)
+
+    block = 0
+    for i in range(num_stores):
+        if rng.random() < branch_density:
+            # if/else on a bit of %c, the else side stores to the same
+            # address half of the time
+            block += 1
+            dst = address()
+            both = rng.random() < 0.5
+            lines += [f"  %m{block} = and i32 %c, {1 << rng.randrange(8)}",
+                      f"  %t{block} = icmp ne i32 %m{block}, 0",
+                      f"  br i1 %t{block}, label %then{block}, "
+                      f"label %else{block}",
+                      f"then{block}:"]
+            lines.append(f"  store i32 {value(i)}, ptr {dst}, align 4")
+            lines += [f"  br label %join{block}", f"else{block}:"]
+            if both:
+                lines.append(f"  store i32 {value(-i)}, ptr {dst}, align 4")
+            lines += [f"  br label %join{block}", f"join{block}:"]
+            continue
+        dst = address()
+        lines.append(f"  store i32 {value(i)}, ptr {dst}, align 4")
+
+    lines.append("  %sum0 = add i32 0, 0")
+    acc = "%sum0"
+    for slot in range(num_slots):
+        if rng.random() < 0.5:
+            continue
+        lines += [f"  %r{slot} = getelementptr inbounds [{num_slots} x i32], "
+                  f"ptr %arr, i64 0, i64 {slot}",
+                  f"  %l{slot} = load i32, ptr %r{slot}, align 4",
+                  f"  %s{slot} = add i32 {acc}, %l{slot}"]
+        acc = f"%s{slot}"
+    lines += [f"  %res = getelementptr inbounds i32, ptr %q, i64 {num_slots}",
+              f"  store i32 {acc}, ptr %res, align 4",
+              "  ret void", "}", ""]
+    return "\n".join(lines)
+
+
+def gen_module(num_functions, num_stores, num_slots, branch_density,
+               alias_ambiguity, rng):
+    words = num_slots + 1
+    out = [f"@bufA = global [{words} x i32] zeroinitializer",
+           f"@bufB = global [{words} x i32] zeroinitializer",
+           '@fmt = private constant [7 x i8] c"%d %u\\0A\\00"',
+           "",
+           "declare i32 @printf(ptr, ...)",
+           "declare void @llvm.memset.p0.i64(ptr, i8, i64, i1)",
+           "",
+           "define i32 @checksum(ptr %a, ptr %b) {",
+           "entry:",
+           "  br label %loop",
+           "loop:",
+           "  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]",
+           "  %h = phi i32 [ 17, %entry ], [ %h.next, %loop ]",
+           "  %pa = getelementptr inbounds i32, ptr %a, i64 %i",
+           "  %va = load i32, ptr %pa, align 4",
+           "  %pb = getelementptr inbounds i32, ptr %b, i64 %i",
+           "  %vb = load i32, ptr %pb, align 4",
+           "  %h1 = mul i32 %h, 31",
+           "  %h2 = add i32 %h1, %va",
+           "  %h3 = mul i32 %h2, 31",
+           "  %h.next = add i32 %h3, %vb",
+           "  %i.next = add i64 %i, 1",
+           f"  %done = icmp eq i64 %i.next, {words}",
+           "  br i1 %done, label %exit, label %loop",
+           "exit:",
+           "  ret i32 %h.next",
+           "}",
+           ""]
+    main = ["define i32 @main() {", "entry:"]
+    for f in range(num_functions):
+        out.append(gen_function(f"f{f}", num_stores, num_slots,
+                                branch_density, alias_ambiguity, rng))
+        q = "@bufA" if rng.random() < alias_ambiguity else "@bufB"
+        main += [f"  call void @f{f}(ptr @bufA, ptr {q}, "
+                 f"i32 {rng.randrange(256)})",
+                 f"  %h{f} = call i32 @checksum(ptr @bufA, ptr @bufB)",
+                 f"  call i32 (ptr, ...) @printf(ptr @fmt, i32 {f}, "
+                 f"i32 %h{f})"]
+    main += ["  ret i32 0", "}", ""]
+    return "\n".join(out + main)
+
+
+def count_stores(path):
+    with open(path) as f:
+        return sum(1 for line in f if line.lstrip().startswith("store "))
+
+
+def run_opt(cmd):
+    """Runs opt, returns (seconds, peak resident set in MiB)."""
+    start = time.perf_counter()
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE)
+    # Drain stderr before waiting: opt blocks once the pipe buffer is full.
+    err = proc.stderr.read().decode()
+    proc.stderr.close()
+    _, status, usage = os.wait4(proc.pid, 0)
+    elapsed = time.perf_counter() - start
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode != 0:
+        sys.exit(f"opt failed: {' '.join(cmd)}\n{err}")
+    return elapsed, usage.ru_maxrss / 1024.0
+
+
+def run_lli(lli, flags, path):
+    res = subprocess.run([lli] + flags + [path], capture_output=True,
+                         text=True)
+    return res.returncode, res.stdout
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--opt", default="opt")
+    ap.add_argument("--lli", default="lli")
+    ap.add_argument("--lli-flags", default="",
+                    help="extra lli flags, e.g. -O0 for large modules")
+    ap.add_argument("--plugin", default="./libDeadStoreElimination.so")
+    ap.add_argument("--plugin-passes", default="dse-mssa")
+    ap.add_argument("--plugin-flags", default="",
+                    help="extra opt flags for the plugin run")
+    ap.add_argument("--stock-passes", default="dse")
+    ap.add_argument("--stores", default="250,1000,4000",
+                    help="stores per function, comma separated")
+    ap.add_argument("--functions", type=int, default=20)
+    ap.add_argument("--slots", type=int, default=32,
+                    help="distinct slots per array and pointer argument")
+    ap.add_argument("--branch-density", type=float, default=0.05,
+                    help="share of stores placed in an if/else")
+    ap.add_argument("--alias-ambiguity", type=float, default=0.2,
+                    help="share of stores through %%p/%%q, and of calls "
+                         "passing the same buffer for both")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--no-run", action="store_true",
+                    help="skip the lli comparison")
+    ap.add_argument("--keep", default=None,
+                    help="directory to keep the generated modules in")
+    args = ap.parse_args()
+
+    configs = [
+        ("none", [f"-passes=verify"]),
+        ("plugin", [f"-load-pass-plugin={args.plugin}",
+                    f"-passes={args.plugin_passes}"]
+         + shlex.split(args.plugin_flags)),
+        ("stock", [f"-passes={args.stock_passes}"]),
+    ]
+    lli_flags = shlex.split(args.lli_flags)
+
+    print(f"{'stores/fn':>9} {'pass':>6} {'stores':>8} {'removed':>8} "
+          f"{'time (s)':>9} {'peak MiB':>9}  lli")
+    failed = False
+    with tempfile.TemporaryDirectory() as tmpdir:
+        workdir = args.keep or tmpdir
+        os.makedirs(workdir, exist_ok=True)
+        for size in (int(s) for s in args.stores.split(",")):
+            rng = random.Random(args.seed)
+            src = os.path.join(workdir, f"dse_compare_{size}.ll")
+            with open(src, "w") as f:
+                f.write(gen_module(args.functions, size, args.slots,
+                                   args.branch_density,
+                                   args.alias_ambiguity, rng))
+
+            before = None
+            expected = None
+            for name, flags in configs:
+                dst = os.path.join(workdir, f"dse_compare_{size}_{name}.ll")
+                elapsed, peak = run_opt([args.opt] + flags +
+                                        [src, "-S", "-o", dst])
+                stores = count_stores(dst)
+                if before is None:
+                    before = stores
+
+                verdict = "-"
+                if not args.no_run:
+                    result = run_lli(args.lli, lli_flags, dst)
+                    if expected is None:
+                        expected = result
+                        verdict = f"exit {result[0]}"
+                    elif result == expected:
+                        verdict = "same"
+                    else:
+                        verdict = "MISMATCH"
+                        failed = True
+                print(f"{size:>9} {name:>6} {stores:>8} "
+                      f"{before - stores:>8} {elapsed:>9.3f} "
+                      f"{peak:>9.1f}  {verdict}")
+
+    if failed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Summarize the optimization remarks written by the DSE pass.
+
+Reads a YAML remark file produced with -pass-remarks-output and counts
+the remarks of the dse-mssa pass by kind and name, so the rejection
+reasons that block the most eliminations show up at the top. Bitstream
+files are converted first with llvm-remarkutil.
+
+Usage:
+    opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-mssa" \
+        -pass-remarks-output=dse.yaml -pass-remarks-filter=dse-mssa \
+        input.ll -disable-output
+    python3 dse_remarks.py dse.yaml
+    python3 dse_remarks.py dse.bitstream --bitstream
+"""
+
+import argparse
+import collections
+import re
+import subprocess
+import sys
+
+HEADER = re.compile(r"^--- !(\w+)")
+FIELD = re.compile(r"^(Pass|Name|Function):\s+'?([^']*)'?\s*$")
+
+
+def read_remarks(text):
+    """Yields (kind, pass, name, function) for each remark document."""
+    kind = None
+    fields = {}
+    for line in text.splitlines():
+        m = HEADER.match(line)
+        if m:
+            kind = m.group(1)
+            fields = {}
+            continue
+        m = FIELD.match(line)
+        if m and kind is not None:
+            fields[m.group(1)] = m.group(2)
+            continue
+        if line == "..." and kind is not None:
+            yield (kind, fields.get("Pass", ""), fields.get("Name", ""),
+                   fields.get("Function", ""))
+            kind = None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file", help="remark file, or - for stdin")
+    ap.add_argument("--bitstream", action="store_true",
+                    help="input is a bitstream remark file")
+    ap.add_argument("--remarkutil", default="llvm-remarkutil")
+    ap.add_argument("--pass-name", default="dse-mssa",
+                    help="only count remarks of this pass")
+    ap.add_argument("--functions", type=int, default=0,
+                    help="also list the N functions with most missed remarks")
+    args = ap.parse_args()
+
+    if args.bitstream:
+        res = subprocess.run([args.remarkutil, "bitstream2yaml", args.file,
+                              "-o", "-"], capture_output=True, text=True)
+        if res.returncode != 0:
+            sys.exit(f"llvm-remarkutil failed: {res.stderr.strip()}")
+        text = res.stdout
+    elif args.file == "-":
+        text = sys.stdin.read()
+    else:
+        with open(args.file) as f:
+            text = f.read()
+
+    counts = collections.Counter()
+    missed_by_function = collections.Counter()
+    for kind, pass_name, name, function in read_remarks(text):
+        if pass_name != args.pass_name:
+            continue
+        counts[(kind, name)] += 1
+        if kind == "Missed":
+            missed_by_function[function] += 1
+
+    for kind in ("Passed", "Missed", "Analysis"):
+        rows = [(n, c) for (k, n), c in counts.items() if k == kind]
+        if not rows:
+            continue
+        print(f"{kind} ({sum(c for _, c in rows)})")
+        for name, count in sorted(rows, key=lambda r: (-r[1], r[0])):
+            print(f"  {count:>8}  {name}")
+
+    if args.functions and missed_by_function:
+        print("Functions with most missed remarks")
+        for function, count in missed_by_function.most_common(args.functions):
+            print(f"  {count:>8}  {function}")
+
+
+if __name__ == "__main__":
+    main()
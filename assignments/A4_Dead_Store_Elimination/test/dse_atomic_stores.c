@@ -0,0 +1,90 @@
+// DSE of atomic stores
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm dse_atomic_stores.c -o dse_atomic_stores.ll
+// Simplify: opt -passes=mem2reg dse_atomic_stores.ll -S -o dse_atomic_stores_simplified.ll
+// Run DSE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-mssa" -dse-atomic-stores dse_atomic_stores_simplified.ll -S -o dse_atomic_stores_optimized.ll
+//
+// C has no unordered atomics, so memory_order_relaxed (monotonic) is the
+// weakest ordering here. Unordered stores, as emitted by JITs for
+// GC-visible fields, follow the same rules.
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+// ============================================================
+// TEST 1: Relaxed store overwritten by a relaxed store
+// ============================================================
+void atomic1_relaxed(_Atomic int *p) {
+    atomic_store_explicit(p, 1, memory_order_relaxed); // DEAD
+    atomic_store_explicit(p, 2, memory_order_relaxed);
+}
+
+// ============================================================
+// TEST 2: Plain store overwritten by a relaxed store
+// ============================================================
+void atomic2_plain_then_relaxed(int *p) {
+    *p = 1;              // DEAD
+    __atomic_store_n(p, 2, __ATOMIC_RELAXED);
+}
+
+// ============================================================
+// TEST 3: Relaxed store to another field in between
+// ============================================================
+struct Pair {
+    _Atomic int a;
+    _Atomic int b;
+};
+
+void atomic3_other_field(struct Pair *s) {
+    atomic_store_explicit(&s->a, 1, memory_order_relaxed); // DEAD
+    atomic_store_explicit(&s->b, 5, memory_order_relaxed);
+    atomic_store_explicit(&s->a, 2, memory_order_relaxed);
+}
+
+// ============================================================
+// TEST 4: NOT dead - the later store is plain
+// ============================================================
+void atomic4_plain_later(int *p) {
+    __atomic_store_n(p, 1, __ATOMIC_RELAXED); // LIVE - a plain store is weaker
+    *p = 2;
+}
+
+// ============================================================
+// TEST 5: NOT dead - a release fence in between
+// ============================================================
+void atomic5_fence(_Atomic int *p) {
+    atomic_store_explicit(p, 1, memory_order_relaxed); // LIVE - another thread may sync on the fence
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(p, 2, memory_order_relaxed);
+}
+
+// ============================================================
+// TEST 6: NOT dead - seq_cst stores keep their current behaviour
+// ============================================================
+void atomic6_seq_cst(_Atomic int *p) {
+    atomic_store(p, 1);  // LIVE - seq_cst
+    atomic_store(p, 2);
+}
+
+// ============================================================
+// TEST 7: NOT dead - volatile
+// ============================================================
+void atomic7_volatile(volatile int *p) {
+    *p = 1;              // LIVE - volatile
+    *p = 2;
+}
+
+int main(void) {
+    _Atomic int x = 0;
+    int y = 0;
+    struct Pair s = {0, 0};
+
+    atomic1_relaxed(&x);
+    atomic2_plain_then_relaxed(&y);
+    atomic3_other_field(&s);
+    atomic4_plain_later(&y);
+    atomic5_fence(&x);
+    atomic6_seq_cst(&x);
+    atomic7_volatile(&y);
+    printf("%d %d %d %d\n", x, y, s.a, s.b);
+    return 0;
+}
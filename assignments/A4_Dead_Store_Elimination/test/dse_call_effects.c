@@ -0,0 +1,92 @@
+// DSE across calls, using the callees' memory effects
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm dse_call_effects.c -o dse_call_effects.ll
+// Simplify: opt -passes=mem2reg dse_call_effects.ll -S -o dse_call_effects_simplified.ll
+// Run DSE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-mssa-ipo" dse_call_effects_simplified.ll -S -o dse_call_effects_optimized.ll
+//
+// dse-mssa-ipo infers memory effects for every function in the module
+// first. With plain dse-mssa only the attributes already in the IR count.
+
+#include <stdio.h>
+#include <string.h>
+
+static int counter;
+
+// Only touches its argument: inferred argmemonly.
+static void bump(int *c) {
+    *c += 1;
+}
+
+// Touches no memory at all: inferred readnone.
+static int square(int x) {
+    return x * x;
+}
+
+// ============================================================
+// TEST 1: Library call reading a different buffer
+// ============================================================
+size_t call1_strlen(int *restrict p, const char *restrict s) {
+    *p = 1;              // DEAD - strlen only reads s
+    size_t n = strlen(s);
+    *p = 2;
+    return n;
+}
+
+// ============================================================
+// TEST 2: Helper that only updates its argument
+// ============================================================
+void call2_helper(int *restrict p) {
+    *p = 1;              // DEAD - bump only touches counter
+    bump(&counter);
+    *p = 2;
+}
+
+// ============================================================
+// TEST 3: Pure helper computing the new value
+// ============================================================
+int call3_pure(int *p, int x) {
+    *p = 1;              // DEAD - square reads no memory
+    int r = square(x);
+    *p = r;
+    return r;
+}
+
+// ============================================================
+// TEST 4: NOT dead - the call reads the stored location
+// ============================================================
+size_t call4_reads(char *p) {
+    p[0] = 'a';          // LIVE - strlen reads p
+    size_t n = strlen(p);
+    p[0] = 'b';
+    return n;
+}
+
+// ============================================================
+// TEST 5: NOT dead - helper gets the stored pointer
+// ============================================================
+void call5_passes_pointer(int *p) {
+    *p = 1;              // LIVE - bump reads *p
+    bump(p);
+    *p = 2;
+}
+
+// ============================================================
+// TEST 6: NOT dead - printf may read anything
+// ============================================================
+void call6_printf(int *p) {
+    *p = 1;              // LIVE - p may point to a global printf can see
+    printf("log\n");
+    *p = 2;
+}
+
+int main(void) {
+    int v = 0;
+    char buf[8] = "xyz";
+    call1_strlen(&v, "hello");
+    call2_helper(&v);
+    call3_pure(&v, 3);
+    call4_reads(buf);
+    call5_passes_pointer(&v);
+    call6_printf(&v);
+    printf("%d %d %s\n", v, counter, buf);
+    return 0;
+}
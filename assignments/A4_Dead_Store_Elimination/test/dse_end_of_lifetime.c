@@ -0,0 +1,139 @@
+// End-of-lifetime DSE test cases (stores to objects that die unread)
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm dse_end_of_lifetime.c -o dse_end_of_lifetime.ll
+// Simplify: opt -passes=mem2reg,inferattrs dse_end_of_lifetime.ll -S -o dse_end_of_lifetime_simplified.ll
+// Run DSE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-mssa" -dse-end-of-lifetime dse_end_of_lifetime_simplified.ll -S -o dse_end_of_lifetime_optimized.ll
+//
+// Note: inferattrs marks free() as nocapture; without it, passing the
+// pointer to free() counts as an escape.
+
+#include <stdlib.h>
+
+void consume(int *p);
+void log_event(int id);
+
+struct Request {
+    int id;
+    int refs;
+    int bytes;
+};
+
+// ============================================================
+// TEST 1: Local array element written but never read again
+// ============================================================
+int eol1_unread_local(int x) {
+    int buf[4];
+    buf[0] = x;      // LIVE - read below
+    buf[1] = 5;      // DEAD - never read before return
+    int v = buf[0];
+    buf[0] = 9;      // DEAD - never read before return
+    return v;
+}
+
+// ============================================================
+// TEST 2: NOT dead - the address escapes to a call
+// ============================================================
+void eol2_escapes(int x) {
+    int local;
+    local = x;       // NOT DEAD - consume() may read it
+    consume(&local);
+    local = 1;       // NOT DEAD - consume() may have kept the pointer
+}
+
+// ============================================================
+// TEST 3: Heap object freed in the same function
+// ============================================================
+int eol3_heap(int x) {
+    int *m = malloc(2 * sizeof(int));
+    m[0] = x;        // LIVE - read below
+    m[1] = 3;        // DEAD - freed without being read
+    int v = m[0];
+    free(m);
+    return v;
+}
+
+// ============================================================
+// TEST 4: Store on one branch only, still never read
+// ============================================================
+int eol4_branch(int x, int c) {
+    int tmp[2];
+    tmp[0] = x;      // LIVE
+    if (c) {
+        tmp[1] = x;  // DEAD
+    }
+    return tmp[0];
+}
+
+// ============================================================
+// TEST 5: Escaped request object poisoned right before free
+// ============================================================
+void eol5_poison(struct Request *r) {
+    r->id = -1;      // DEAD - freed next, nothing reads it
+    r->refs = 0;     // DEAD
+    free(r);
+}
+
+// ============================================================
+// TEST 6: Free in a later block that post-dominates the store
+// ============================================================
+void eol6_free_later(struct Request *r, int verbose) {
+    r->bytes = 0;    // DEAD - every path reaches free(r) unread
+    if (verbose)
+        r->refs--;   // DEAD - also freed unread
+    free(r);
+}
+
+// ============================================================
+// TEST 7: NOT dead - only one path frees
+// ============================================================
+void eol7_free_one_path(struct Request *r, int done) {
+    r->refs = 0;     // LIVE - the caller still sees r when !done
+    if (done)
+        free(r);
+}
+
+// ============================================================
+// TEST 8: NOT dead - a call may read the object first
+// ============================================================
+void eol8_logged(struct Request *r) {
+    r->id = 0;       // LIVE - log_event may read *r through a global
+    log_event(1);
+    free(r);
+}
+
+// ============================================================
+// TEST 9: NOT dead - realloc may fail and leave the old block
+// ============================================================
+int *eol9_realloc(int *v) {
+    v[0] = 1;        // LIVE - copied into the new block
+    v[4] = 2;        // NOT DEAD - still readable in v if realloc fails
+    return realloc(v, 4 * sizeof(int));
+}
+
+// ============================================================
+// TEST 10: NOT dead - the next iteration reads the element back
+// ============================================================
+int eol10_prev_element(int n) {
+    int a[16];
+    int sum = 0;
+    a[0] = 0;
+    for (int i = 1; i < n && i < 16; i++) {
+        a[i] = i;    // LIVE - read as a[i - 1] on the next iteration
+        sum += a[i - 1];
+    }
+    return sum;
+}
+
+int main() {
+    eol1_unread_local(1);
+    eol2_escapes(2);
+    eol3_heap(3);
+    eol4_branch(4, 1);
+    eol5_poison(malloc(sizeof(struct Request)));
+    eol6_free_later(malloc(sizeof(struct Request)), 1);
+    struct Request *r = malloc(sizeof(struct Request));
+    eol7_free_one_path(r, 1);
+    eol8_logged(malloc(sizeof(struct Request)));
+    free(eol9_realloc(malloc(8 * sizeof(int))));
+    eol10_prev_element(8);
+    return 0;
+}
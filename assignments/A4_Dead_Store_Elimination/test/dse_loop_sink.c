@@ -0,0 +1,104 @@
+// Loop-aware DSE test cases (stores overwritten on every iteration)
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm dse_loop_sink.c -o dse_loop_sink.ll
+// Simplify: opt -passes="mem2reg,loop-rotate" dse_loop_sink.ll -S -o dse_loop_sink_simplified.ll
+// Run DSE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-mssa" -dse-loop-sink dse_loop_sink_simplified.ll -S -o dse_loop_sink_optimized.ll
+//
+// loop-rotate matters: in an unrotated for-loop the header is the only
+// exiting block and the body, with the store, may not run at all.
+
+#include <stdio.h>
+
+struct Stats {
+    int last;
+    int count;
+};
+
+// ============================================================
+// TEST 1: Accumulation kernel writing its output every iteration
+// ============================================================
+void loop1_accumulate(int *restrict out, const int *restrict in, int n) {
+    int sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += in[i];
+        *out = sum;      // SUNK - one store of the final sum after the loop
+    }
+}
+
+// ============================================================
+// TEST 2: do-while, no rotation needed
+// ============================================================
+void loop2_do_while(int *restrict p, int n) {
+    int i = 0;
+    do {
+        *p = i * 3;      // SUNK
+        i++;
+    } while (i < n);
+}
+
+// ============================================================
+// TEST 3: Field of a struct, other field read in the loop
+// ============================================================
+void loop3_struct_field(struct Stats *restrict s, const int *restrict v, int n) {
+    for (int i = 0; i < n; i++) {
+        s->last = v[i] + s->count; // SUNK - s->count is a different field
+    }
+}
+
+// ============================================================
+// TEST 4: NOT sunk - location read inside the loop
+// ============================================================
+void loop4_read_in_loop(int *restrict p, int *restrict q, int n) {
+    for (int i = 0; i < n; i++) {
+        *p = i;          // LIVE - read back below
+        *q += *p;
+    }
+}
+
+// ============================================================
+// TEST 5: NOT sunk - store only on some iterations
+// ============================================================
+void loop5_conditional(int *restrict p, const int *restrict v, int n) {
+    for (int i = 0; i < n; i++) {
+        if (v[i] > 0)
+            *p = v[i];   // LIVE - the last iteration may not store
+    }
+}
+
+// ============================================================
+// TEST 6: NOT sunk - a call may read the location
+// ============================================================
+void loop6_call(int *p, int n) {
+    for (int i = 0; i < n; i++) {
+        *p = i;          // LIVE - printf could see *p
+        printf("%d\n", i);
+    }
+}
+
+// ============================================================
+// TEST 7: NOT sunk - address changes every iteration
+// ============================================================
+void loop7_variant_address(int *restrict a, int n) {
+    for (int i = 0; i < n; i++)
+        a[i] = i;        // LIVE - a different element each time
+}
+
+int main(void) {
+    int in[4] = {1, 2, 3, 4};
+    int out = 0, q = 0;
+    struct Stats s = {0, 0};
+
+    loop1_accumulate(&out, in, 4);
+    printf("loop1: %d\n", out);
+    loop2_do_while(&out, 3);
+    printf("loop2: %d\n", out);
+    loop3_struct_field(&s, in, 4);
+    printf("loop3: %d\n", s.last);
+    loop4_read_in_loop(&out, &q, 4);
+    printf("loop4: %d %d\n", out, q);
+    loop5_conditional(&out, in, 4);
+    printf("loop5: %d\n", out);
+    loop6_call(&out, 2);
+    loop7_variant_address(in, 4);
+    printf("loop7: %d\n", in[3]);
+    return 0;
+}
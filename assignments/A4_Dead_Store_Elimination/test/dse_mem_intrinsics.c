@@ -0,0 +1,77 @@
+// memset/memcpy-aware DSE test cases (intrinsic deletion and trimming)
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm dse_mem_intrinsics.c -o dse_mem_intrinsics.ll
+// Simplify: opt -passes=mem2reg dse_mem_intrinsics.ll -S -o dse_mem_intrinsics_simplified.ll
+// Run DSE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-mssa" -dse-mem-intrinsics dse_mem_intrinsics_simplified.ll -S -o dse_mem_intrinsics_optimized.ll
+
+#include <string.h>
+
+struct Request {
+    long id;
+    long flags;
+    char body[48];
+};
+
+// ============================================================
+// TEST 1: Buffer reset, then the header is written straight away
+// ============================================================
+void mi1_reset_then_header(struct Request *r, long id) {
+    memset(r, 0, sizeof(*r));   // TRIMMED - first 16 bytes overwritten
+    r->id = id;
+    r->flags = 1;
+}
+
+// ============================================================
+// TEST 2: Scalar store inside a later memset
+// ============================================================
+void mi2_store_then_memset(struct Request *r) {
+    r->flags = 7;               // DEAD - cleared by the memset
+    memset(r, 0, sizeof(*r));
+}
+
+// ============================================================
+// TEST 3: memset fully overwritten
+// ============================================================
+void mi3_memset_overwritten(long *p) {
+    memset(p, 0, sizeof(long)); // DEAD
+    *p = 5;
+}
+
+// ============================================================
+// TEST 4: memcpy whose tail is overwritten
+// ============================================================
+void mi4_memcpy_tail(char *dst, const char *restrict src) {
+    memcpy(dst, src, 16);       // TRIMMED to 8 bytes
+    memset(dst + 8, 1, 8);
+}
+
+// ============================================================
+// TEST 5: NOT dead - memcpy reads the stored value
+// ============================================================
+void mi5_memcpy_reads(int *a) {
+    a[0] = 3;                   // NOT DEAD - copied below
+    memcpy(&a[4], &a[0], sizeof(int));
+    a[0] = 4;
+}
+
+// ============================================================
+// TEST 6: NOT dead here - only plain stores cover it
+// ============================================================
+void mi6_plain_stores_only(int *a) {
+    *(long *)a = 0;             // NOT DEAD - needs -dse-partial-overwrite
+    a[0] = 1;
+    a[1] = 2;
+}
+
+int main() {
+    struct Request r;
+    long l;
+    char buf[16], src[16] = {0};
+    int arr[8];
+    mi1_reset_then_header(&r, 1);
+    mi2_store_then_memset(&r);
+    mi3_memset_overwritten(&l);
+    mi4_memcpy_tail(buf, src);
+    mi5_memcpy_reads(arr);
+    mi6_plain_stores_only(arr);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// No-op store test cases ("store (load p), p")
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm dse_noop_store.c -o dse_noop_store.ll
+// Simplify: opt -passes=mem2reg dse_noop_store.ll -S -o dse_noop_store_simplified.ll
+// Run DSE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-mssa" -dse-noop-stores dse_noop_store_simplified.ll -S -o dse_noop_store_optimized.ll
+
+struct Account {
+    int id;
+    int balance;
+};
+
+// ============================================================
+// TEST 1: Value written straight back
+// ============================================================
+void noop1_write_back(int *p) {
+    int v = *p;
+    *p = v;          // NO-OP - removed
+}
+
+// ============================================================
+// TEST 2: Generated accessor copying a field onto itself
+// ============================================================
+void noop2_accessor(struct Account *a, int *other) {
+    int b = a->balance;
+    *other = 0;      // may alias a->balance
+    a->balance = b;  // NOT NO-OP - *other may have changed the field
+}
+
+// ============================================================
+// TEST 3: Unrelated restrict pointer written in between
+// ============================================================
+void noop3_restrict(int *restrict p, int *restrict q) {
+    int v = *p;
+    *q = 1;          // cannot alias p
+    *p = v;          // NO-OP - removed
+}
+
+// ============================================================
+// TEST 4: NOT no-op - one branch overwrites the location
+// ============================================================
+void noop4_branch(int *p, int c) {
+    int v = *p;
+    if (c) {
+        *p = 4;
+    }
+    *p = v;          // NOT NO-OP - restores the old value on one path
+}
+
+int main() {
+    int x = 1, y = 2;
+    struct Account acc = {1, 100};
+    noop1_write_back(&x);
+    noop2_accessor(&acc, &y);
+    noop3_restrict(&x, &y);
+    noop4_branch(&x, 1);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Partial-overwrite DSE test cases (byte-range tracking, shrinking, merging)
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm dse_partial_overwrite.c -o dse_partial_overwrite.ll
+// Simplify: opt -passes=mem2reg dse_partial_overwrite.ll -S -o dse_partial_overwrite_simplified.ll
+// Run DSE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-mssa" -dse-partial-overwrite dse_partial_overwrite_simplified.ll -S -o dse_partial_overwrite_optimized.ll
+
+struct Pair {
+    int a;
+    int b;
+};
+
+struct Bytes {
+    unsigned char b0, b1, b2, b3;
+};
+
+// ============================================================
+// TEST 1: Wide store covered by two narrower stores
+// ============================================================
+void po1_covered_by_fields(long long *p) {
+    *p = 0;                          // DEAD - both halves overwritten
+    ((struct Pair *)p)->a = 1;       // merged with the next store
+    ((struct Pair *)p)->b = 2;
+}
+
+// ============================================================
+// TEST 2: Narrow store inside a later wide store
+// ============================================================
+void po2_inside_wide(long long *p) {
+    ((unsigned char *)p)[2] = 7;     // DEAD - inside the 8-byte store
+    *p = 0;                          // LIVE
+}
+
+// ============================================================
+// TEST 3: Partially covered constant store is shrunk
+// ============================================================
+void po3_shrink(long long *p) {
+    *p = 0x1122334455667788LL;       // SHRUNK to its low 4 bytes
+    ((int *)p)[1] = 0;               // LIVE
+}
+
+// ============================================================
+// TEST 4: NOT dead - a load reads part of the wide store first
+// ============================================================
+int po4_read_between(long long *p) {
+    *p = 0;                          // SHRUNK - only the first half is read
+    int v = ((int *)p)[0];
+    ((struct Pair *)p)->a = 1;
+    ((struct Pair *)p)->b = 2;
+    return v;
+}
+
+// ============================================================
+// TEST 5: Byte-wise initialisation merged into one 4-byte store
+// ============================================================
+void po5_merge_bytes(struct Bytes *s) {
+    s->b0 = 1;                       // MERGED
+    s->b1 = 2;                       // MERGED
+    s->b2 = 3;                       // MERGED
+    s->b3 = 4;                       // MERGED
+}
+
+// ============================================================
+// TEST 6: NOT merged - a call sits between the stores
+// ============================================================
+void external_use(struct Bytes *s);
+
+void po6_no_merge_across_call(struct Bytes *s) {
+    s->b0 = 1;
+    external_use(s);
+    s->b1 = 2;
+}
+
+int main() {
+    long long x;
+    struct Bytes b;
+    po1_covered_by_fields(&x);
+    po2_inside_wide(&x);
+    po3_shrink(&x);
+    po4_read_between(&x);
+    po5_merge_bytes(&b);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Path-sensitive DSE test cases (stores killed across MemoryPhi merges)
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm dse_path_sensitive.c -o dse_path_sensitive.ll
+// Simplify: opt -passes=mem2reg dse_path_sensitive.ll -S -o dse_path_sensitive_simplified.ll
+// Run DSE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-mssa" -dse-path-sensitive dse_path_sensitive_simplified.ll -S -o dse_path_sensitive_optimized.ll
+
+// ============================================================
+// TEST 1: Stores on both sides of a diamond, killed after the merge
+// ============================================================
+void ps1_diamond(int *p, int c) {
+    if (c) {
+        *p = 1;      // DEAD - overwritten after the merge
+    } else {
+        *p = 2;      // DEAD - overwritten after the merge
+    }
+    *p = 3;          // LIVE
+}
+
+// ============================================================
+// TEST 2: Store before a diamond, each arm overwrites it
+// ============================================================
+void ps2_killed_by_both_arms(int *p, int c) {
+    *p = 0;          // DEAD - no single killer, but every path overwrites
+    if (c) {
+        *p = 1;      // LIVE
+    } else {
+        *p = 2;      // LIVE
+    }
+}
+
+// ============================================================
+// TEST 3: Switch fan-out
+// ============================================================
+void ps3_switch(int *p, int k) {
+    switch (k) {
+    case 0:  *p = 10; break;   // DEAD
+    case 1:  *p = 11; break;   // DEAD
+    default: *p = 12; break;   // DEAD
+    }
+    *p = 13;                   // LIVE
+}
+
+// ============================================================
+// TEST 4: NOT dead - one arm reads the value before the merge
+// ============================================================
+int ps4_read_on_one_path(int *p, int c) {
+    int r = 0;
+    if (c) {
+        *p = 1;      // DEAD
+    } else {
+        *p = 2;      // NOT DEAD - read below
+        r = *p;
+    }
+    *p = 3;          // LIVE
+    return r;
+}
+
+// ============================================================
+// TEST 5: NOT dead - one arm returns early
+// ============================================================
+int ps5_early_exit(int *p, int c) {
+    *p = 0;          // NOT DEAD - final value on the early return
+    if (c) {
+        return 1;
+    }
+    *p = 1;
+    return 0;
+}
+
+// ============================================================
+// TEST 6: NOT dead - only one arm overwrites
+// ============================================================
+void ps6_one_arm(int *p, int c) {
+    *p = 0;          // NOT DEAD
+    if (c) {
+        *p = 1;
+    }
+}
+
+// ============================================================
+// TEST 7: NOT dead - the next write is to a different element
+// ============================================================
+void ps7_loop_index(int *a, int n) {
+    int i = 0;
+    for (;;) {
+        a[i] = 0;    // LIVE - final value when the loop exits here
+        if (i >= n)
+            break;
+        a[i] = 1;    // NOT DEAD - the next iteration writes a[i + 1]
+        i++;
+    }
+}
+
+int main() {
+    int x;
+    ps1_diamond(&x, 1);
+    ps2_killed_by_both_arms(&x, 0);
+    ps3_switch(&x, 2);
+    ps4_read_on_one_path(&x, 0);
+    ps5_early_exit(&x, 1);
+    ps6_one_arm(&x, 1);
+    int arr[4];
+    ps7_loop_index(arr, 2);
+    return 0;
+}
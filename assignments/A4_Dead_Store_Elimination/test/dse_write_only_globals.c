@@ -0,0 +1,57 @@
+// Whole-module DSE of write-only globals
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm dse_write_only_globals.c -o dse_write_only_globals.ll
+// Simplify: opt -passes=mem2reg dse_write_only_globals.ll -S -o dse_write_only_globals_simplified.ll
+// Run DSE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="dse-globals" dse_write_only_globals_simplified.ll -S -o dse_write_only_globals_optimized.ll
+//
+// Only static globals qualify: another translation unit may read anything
+// with external linkage.
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+static int debug_calls;              // REMOVED - only incremented
+static long bytes_seen;              // REMOVED - only accumulated
+static int last_key[4];              // REMOVED - stale cache, never read
+static _Atomic int hits;             // REMOVED - atomic increment, result unused
+static int pairs[8];                 // REMOVED - read at a variable index only to update it
+
+static int total;                    // KEPT - printed in main
+static int registered;               // KEPT - its address is passed out
+int exported;                        // KEPT - external linkage
+static volatile int heartbeat;       // KEPT - volatile
+
+static void track(int *slot) {
+    (void)slot;
+}
+
+// ============================================================
+// TEST 1: Debug counters and a stale cache
+// ============================================================
+int work(int key, int len) {
+    debug_calls++;
+    bytes_seen += len;
+    last_key[key & 3] = key;
+    atomic_fetch_add_explicit(&hits, 1, memory_order_relaxed);
+    pairs[key & 7] = pairs[(key ^ 1) & 7] + len;
+    total += len;
+    return key * 2;
+}
+
+// ============================================================
+// TEST 2: NOT removed - address escapes, external or volatile
+// ============================================================
+void publish(int v) {
+    registered = v;
+    track(&registered);
+    exported = v;
+    heartbeat = v;
+}
+
+int main(void) {
+    int r = 0;
+    for (int i = 0; i < 4; i++)
+        r += work(i, 10);
+    publish(r);
+    printf("%d %d\n", r, total);
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Redundant load elimination / store-to-load forwarding test cases
+// Compile: clang -O0 -Xclang -disable-O0-optnone -S -emit-llvm rle_store_forwarding.c -o rle_store_forwarding.ll
+// Simplify: opt -passes=mem2reg rle_store_forwarding.ll -S -o rle_store_forwarding_simplified.ll
+// Run RLE: opt -load-pass-plugin=./libDeadStoreElimination.so -passes="rle-mssa" rle_store_forwarding_simplified.ll -S -o rle_store_forwarding_optimized.ll
+//
+// Run "rle-mssa,dse-mssa" to see stores that only lived for a reload
+// removed as well.
+
+#include <stdio.h>
+
+struct Node {
+    int key;
+    int count;
+    struct Node *next;
+};
+
+union Bits {
+    unsigned u;
+    float f;
+};
+
+// ============================================================
+// TEST 1: Reload right after a store
+// ============================================================
+int rle1_reload(int *p, int v) {
+    *p = v * 2;
+    return *p + 1;       // FORWARDED - the load becomes v * 2
+}
+
+// ============================================================
+// TEST 2: Narrower reload of a wider store
+// ============================================================
+short rle2_truncate(long long *p, long long v) {
+    *p = v;
+    return *(short *)p;  // FORWARDED - a truncation of v
+}
+
+// ============================================================
+// TEST 3: Same bits, different type
+// ============================================================
+float rle3_bitcast(union Bits *b, unsigned bits) {
+    b->u = bits;
+    return b->f;         // FORWARDED - a bitcast of bits
+}
+
+// ============================================================
+// TEST 4: Field reloaded across a store to another field
+// ============================================================
+int rle4_fields(struct Node *n) {
+    n->count = n->key;
+    n->key = 0;
+    return n->count;     // FORWARDED - key is a different field
+}
+
+// ============================================================
+// TEST 5: Same pointer loaded twice
+// ============================================================
+int rle5_reuse(struct Node *restrict n, int *restrict out) {
+    int a = n->key;
+    *out = a;
+    return n->key + a;   // REUSED - out cannot point into n
+}
+
+// ============================================================
+// TEST 6: Reuse across a branch that does not write the location
+// ============================================================
+int rle6_branch(int *restrict p, int *restrict q, int c) {
+    int a = *p;
+    if (c)
+        *q = 1;
+    return *p + a;       // REUSED - neither path writes *p
+}
+
+// ============================================================
+// TEST 7: NOT forwarded - the other pointer may alias
+// ============================================================
+int rle7_may_alias(int *p, int *q) {
+    *p = 1;
+    *q = 2;
+    return *p;           // KEPT - q may point to *p
+}
+
+// ============================================================
+// TEST 8: NOT forwarded - the load is wider than the store
+// ============================================================
+long long rle8_wider(long long *p, int v) {
+    *(int *)p = v;
+    return *p;           // KEPT - the upper bytes were not stored
+}
+
+// ============================================================
+// TEST 9: NOT reused - a call may write the location
+// ============================================================
+int rle9_call(int *p) {
+    int a = *p;
+    printf("%d\n", a);
+    return *p;           // KEPT - printf may write *p
+}
+
+// ============================================================
+// TEST 10: NOT reused - the loop writes the location
+// ============================================================
+int rle10_loop(int *p, int n) {
+    int sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += *p;       // KEPT - changes on every iteration
+        *p = i;
+    }
+    return sum;
+}
+
+int main(void) {
+    int x = 0, y = 0;
+    long long w = 0;
+    union Bits b;
+    struct Node n = {3, 0, NULL};
+
+    printf("%d\n", rle1_reload(&x, 4));
+    printf("%d\n", rle2_truncate(&w, 0x12345));
+    printf("%f\n", rle3_bitcast(&b, 0x3f800000u));
+    printf("%d\n", rle4_fields(&n));
+    n.key = 5;
+    printf("%d\n", rle5_reuse(&n, &y));
+    printf("%d\n", rle6_branch(&x, &y, 1));
+    printf("%d\n", rle7_may_alias(&x, &x));
+    printf("%lld\n", rle8_wider(&w, 7));
+    printf("%d\n", rle9_call(&x));
+    printf("%d\n", rle10_loop(&x, 4));
+    return 0;
+}